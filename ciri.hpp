@@ -18,6 +18,83 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <system_error>
+#include <optional>
+#include <array>
+#include <deque>
+#include <ostream>
+#include <istream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string_view>
+#include <exception>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#if __has_include(<span>)
+  #include <span>
+#endif
+
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+  #include <coroutine>
+  #ifdef __cpp_lib_coroutine
+    #define CIRI_COROUTINE
+  #endif
+#endif
+
+#if __has_include(<memory_resource>)
+  #include <memory_resource>
+  #ifdef __cpp_lib_memory_resource
+    #define CIRI_PMR
+  #endif
+#endif
+
+// SIMD instruction sets enabled by the compiler flags
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define CIRI_SSE2
+  #include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+  #define CIRI_AVX2
+  #include <immintrin.h>
+#endif
+
+// CRC32C instructions, dispatched at run time where the compiler allows it
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+  #define CIRI_CRC32C_HW __attribute__((target("sse4.2,pclmul")))
+  #define CIRI_CRC32C_HW_SUPPORTED() (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul"))
+#elif defined(_MSC_VER) && defined(_M_X64) && defined(__AVX__)
+  #define CIRI_CRC32C_HW
+  #define CIRI_CRC32C_HW_SUPPORTED() true
+#endif
+
+#ifdef CIRI_CRC32C_HW_SUPPORTED
+  #include <nmmintrin.h>
+  #include <wmmintrin.h>
+#endif
+
+// F16C half-precision conversions, dispatched the same way
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+  #define CIRI_F16C_HW __attribute__((target("avx,f16c")))
+  #define CIRI_F16C_HW_SUPPORTED() (__builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c"))
+#elif defined(_MSC_VER) && defined(_M_X64) && defined(__AVX2__)
+  #define CIRI_F16C_HW
+  #define CIRI_F16C_HW_SUPPORTED() true
+#endif
+
+#ifdef CIRI_F16C_HW_SUPPORTED
+  #include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
 
 namespace ciri {
 
@@ -35,6 +112,31 @@ struct is_std_basic_string <std::basic_string<ArgsT...>> : std::true_type {};
 template <typename T> 
 constexpr bool is_std_basic_string_v = is_std_basic_string<T>::value;
 
+// std::basic_string_view
+template <typename T> 
+struct is_std_basic_string_view : std::false_type {};
+
+template <typename... ArgsT> 
+struct is_std_basic_string_view <std::basic_string_view<ArgsT...>> : std::true_type {};
+
+template <typename T> 
+constexpr bool is_std_basic_string_view_v = is_std_basic_string_view<T>::value;
+
+// character types of std::basic_string
+template <typename T> 
+struct is_character : std::false_type {};
+
+template <> struct is_character<char> : std::true_type {};
+template <> struct is_character<wchar_t> : std::true_type {};
+template <> struct is_character<char16_t> : std::true_type {};
+template <> struct is_character<char32_t> : std::true_type {};
+#ifdef __cpp_char8_t
+template <> struct is_character<char8_t> : std::true_type {};
+#endif
+
+template <typename T> 
+constexpr bool is_character_v = is_character<std::remove_cv_t<T>>::value;
+
 // std::array
 template <typename T> 
 struct is_std_array : std::false_type {};
@@ -194,6 +296,150 @@ struct is_std_tuple<std::tuple<ArgsT...>> : std::true_type {};
 template <typename T> 
 constexpr bool is_std_tuple_v = is_std_tuple<T>::value;
 
+// ----------------------------------------------------------------------------
+// Device traits
+// ----------------------------------------------------------------------------
+
+// has_view
+template <typename T, typename = void>
+struct has_view : std::false_type {};
+
+template <typename T>
+struct has_view <T, std::void_t<decltype(std::declval<T&>().view(std::streamsize{}))>> : std::true_type {};
+
+template <typename T>
+constexpr bool has_view_v = has_view<T>::value;
+
+// has_ignore
+template <typename T, typename = void>
+struct has_ignore : std::false_type {};
+
+template <typename T>
+struct has_ignore <T, std::void_t<decltype(std::declval<T&>().ignore(std::streamsize{}))>> : std::true_type {};
+
+template <typename T>
+constexpr bool has_ignore_v = has_ignore<T>::value;
+
+// has_parallel
+template <typename T, typename = void>
+struct has_parallel : std::false_type {};
+
+template <typename T>
+struct has_parallel <T, std::void_t<decltype(std::declval<const T&>().parallel())>> : std::true_type {};
+
+template <typename T>
+constexpr bool has_parallel_v = has_parallel<T>::value;
+
+// ----------------------------------------------------------------------------
+// SIMD
+// ----------------------------------------------------------------------------
+
+#ifdef CIRI_SSE2
+// Function: simd_broadcast
+// Replicates the bytes of a 1-, 2-, 4-, or 8-byte value across a 128-bit lane.
+template <typename T>
+__m128i simd_broadcast(const T& value) {
+  if constexpr(sizeof(T) == 1) {
+    int8_t bits;
+    std::memcpy(&bits, &value, 1);
+    return _mm_set1_epi8(bits);
+  }
+  else if constexpr(sizeof(T) == 2) {
+    int16_t bits;
+    std::memcpy(&bits, &value, 2);
+    return _mm_set1_epi16(bits);
+  }
+  else if constexpr(sizeof(T) == 4) {
+    int32_t bits;
+    std::memcpy(&bits, &value, 4);
+    return _mm_set1_epi32(bits);
+  }
+  else {
+    static_assert(sizeof(T) == 8, "Broadcast requires a 1-, 2-, 4-, or 8-byte value");
+    int64_t bits;
+    std::memcpy(&bits, &value, 8);
+    return _mm_set1_epi64x(bits);
+  }
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// Error
+// ----------------------------------------------------------------------------
+
+// Procedure: throw_error
+// Reports malformed or incompatible input as a std::system_error.
+[[noreturn]] inline void throw_error(std::errc ec, const char* what) {
+  throw std::system_error(std::make_error_code(ec), what);
+}
+
+// ----------------------------------------------------------------------------
+// Bit manipulation
+// ----------------------------------------------------------------------------
+
+// Function: popcount
+inline size_t popcount(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(x);
+#else
+  size_t n = 0;
+  for(; x; x &= x - 1) {
+    ++n;
+  }
+  return n;
+#endif
+}
+
+// Function: countr_zero
+// Counts the trailing zero bits of a non-zero word.
+inline size_t countr_zero(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctz(x);
+#elif defined(_MSC_VER)
+  unsigned long i;
+  _BitScanForward(&i, x);
+  return i;
+#else
+  size_t n = 0;
+  for(; !(x & 1); x >>= 1) {
+    ++n;
+  }
+  return n;
+#endif
+}
+
+// Function: countr_zero
+inline size_t countr_zero(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long i;
+  _BitScanForward64(&i, x);
+  return i;
+#else
+  size_t n = 0;
+  for(; !(x & 1); x >>= 1) {
+    ++n;
+  }
+  return n;
+#endif
+}
+
+// Function: popcount
+// Counts the set bits of a byte array.
+inline size_t popcount(const uint8_t* bytes, size_t num_bytes) {
+  size_t n = 0, i = 0;
+  for(; i + 8 <= num_bytes; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    n += popcount(word);
+  }
+  for(; i < num_bytes; ++i) {
+    n += popcount(bytes[i]);
+  }
+  return n;
+}
+
 //-----------------------------------------------------------------------------
 // Type extraction.
 //-----------------------------------------------------------------------------
@@ -296,419 +542,7079 @@ MapItem<KeyT, ValueT> make_kv_pair(KeyT&& k, ValueT&& v) {
   return { std::forward<KeyT>(k), std::forward<ValueT>(v) };
 }
 
+// ----------------------------------------------------------------------------
+// View
 // ----------------------------------------------------------------------------
 
-// Class: Serializer
-template <typename Device = std::ostream, typename SizeType = std::streamsize>
-class Serializer {
+// Class: Span
+// Non-owning view of a contiguous sequence, standing in for std::span 
+// before C++20. 
+template <typename T>
+class Span {
 
   public:
-    
-    Serializer(Device& device);
-    
-    template <typename... T>
-    SizeType operator()(T&&... items);
-  
+
+    using element_type = T;
+    using value_type = std::remove_cv_t<T>;
+    using size_type = size_t;
+    using iterator = T*;
+
+    Span() = default;
+    Span(T* data, size_t size) : _data(data), _size(size) {}
+
+    template <typename C, typename = std::void_t<decltype(std::data(std::declval<C&>()))>>
+    Span(C& c) : _data(std::data(c)), _size(std::size(c)) {}
+
+    inline T* data() const { return _data; }
+    inline size_t size() const { return _size; }
+    inline bool empty() const { return _size == 0; }
+    inline T* begin() const { return _data; }
+    inline T* end() const { return _data + _size; }
+    inline T& operator [] (size_t i) const { return _data[i]; }
+
   private:
 
-    Device& _device;
+    T* _data {nullptr};
+    size_t _size {0};
+};
+
+// is_span
+template <typename T>
+struct is_span : std::false_type {};
+
+template <typename T>
+struct is_span <Span<T>> : std::true_type {};
+
+#ifdef __cpp_lib_span
+template <typename T, size_t N>
+struct is_span <std::span<T, N>> : std::true_type {};
+#endif
+
+template <typename T>
+constexpr bool is_span_v = is_span<T>::value;
+
+// Class: Into
+// Class that wraps caller-provided storage of arithmetic values. It loads 
+// into the storage without allocating, storing the number of values read 
+// in size, and saves the first size values. It uses the wire format of 
+// std::vector and std::basic_string. An encoded length over the capacity 
+// is reported rather than thrown: size is set to that length, the storage 
+// holds the first capacity values, and the rest are skipped, so the load 
+// goes on with the next item and stays free of heap activity.
+template <typename T>
+class Into {
+
+  public:
+
+    Into(T* data, size_t capacity, size_t& size) : 
+      _data(data), _capacity(capacity), _size(size) {}
     
-    template <typename T>
-    SizeType _save(T&&);
+    Into& operator = (const Into&) = delete;
+
+    inline T* data() const { return _data; }
+    inline size_t capacity() const { return _capacity; }
+    inline size_t& size() const { return _size; }
+
+    // Returns whether the last load found more values than the capacity.
+    inline bool truncated() const { return _size > _capacity; }
+
+  private:
+
+    T* _data;
+    size_t _capacity;
+    size_t& _size;
 };
 
-// Constructor
-template <typename Device, typename SizeType>
-Serializer<Device, SizeType>::Serializer(Device& device) : _device(device) {
+// Function: make_into
+template <typename T>
+Into<T> make_into(T* data, size_t capacity, size_t& size) {
+  static_assert(std::is_arithmetic_v<T>, "Into requires arithmetic values");
+  return { data, capacity, size };
 }
 
-// Operator ()
-template <typename Device, typename SizeType>
-template <typename... T>
-SizeType Serializer<Device, SizeType>::operator() (T&&... items) {
-  return (_save(std::forward<T>(items)) + ...);
+// Function: make_into
+// Uses the whole of a contiguous range, such as a span, a std::array, or a 
+// C array, as the storage.
+template <typename C>
+auto make_into(C&& c, size_t& size) {
+  return make_into(std::data(c), std::size(c), size);
 }
 
-// Function: _save
-template <typename Device, typename SizeType>
+// is_into
 template <typename T>
-SizeType Serializer<Device, SizeType>::_save(T&& t) {
+struct is_into : std::false_type {};
 
-  using U = std::decay_t<T>;
-  
-  // arithmetic data type
-  if constexpr(std::is_arithmetic_v<U>) {
-    _device.write(reinterpret_cast<const char*>(std::addressof(t)), sizeof(t));
-    return sizeof(t);
-  }
-  // std::basic_string
-  else if constexpr(is_std_basic_string_v<U>) {
-    auto sz = _save(make_size_tag(t.size()));
-    _device.write(reinterpret_cast<const char*>(t.data()), t.size()*sizeof(typename U::value_type));
-    return sz + t.size()*sizeof(typename U::value_type);
-  }
-  // std::vector
-  else if constexpr(is_std_vector_v<U>) {
-    if constexpr (std::is_arithmetic_v<typename U::value_type>) {
-      auto sz = _save(make_size_tag(t.size()));
-      _device.write(reinterpret_cast<const char*>(t.data()), t.size() * sizeof(typename U::value_type));
-      return sz + t.size() * sizeof(typename U::value_type);
-    } else {
-      auto sz = _save(make_size_tag(t.size()));
-      for(auto&& item : t) {
-        sz += _save(item);
-      }
-      return sz;
-    }
-  }
-  // std::deque and std::list
-  else if constexpr(is_std_deque_v<U> || is_std_list_v<U>) {
-    auto sz = _save(make_size_tag(t.size()));
-    for(auto&& item : t) {
-      sz += _save(item);
-    }
-    return sz;
-  }
-  // std::forward_list
-  else if constexpr(is_std_forward_list_v<U>) {
-    auto sz = _save(make_size_tag(std::distance(t.begin(), t.end())));
-    for(auto&& item : t) {
-      sz += _save(item);
-    }
-    return sz;
-  }
-  // std::map and std::unordered_map
-  else if constexpr(is_std_map_v<U> || is_std_unordered_map_v<U>) {
-    auto sz = _save(make_size_tag(t.size()));
-    for(auto&& [k, v] : t) {
-      sz += _save(make_kv_pair(k, v));
-    }
-    return sz;
-  }
-  // std::set and std::unordered_set
-  else if constexpr(is_std_set_v<U> || is_std_unordered_set_v<U>) {
-    auto sz = _save(make_size_tag(t.size()));
-    for(auto&& item : t) {
-      sz += _save(item);
+template <typename T>
+struct is_into <Into<T>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_into_v = is_into<T>::value;
+
+// ----------------------------------------------------------------------------
+// Allocator
+// ----------------------------------------------------------------------------
+
+// Class: DefaultInitAllocator
+// Allocator adaptor that default-initializes instead of value-initializing,
+// so resize leaves arithmetic values uninitialized. Containers using it,
+// e.g., std::vector<float, DefaultInitAllocator<float>>, skip the zero fill 
+// before the deserializer overwrites their contents.
+template <typename T, typename A = std::allocator<T>>
+class DefaultInitAllocator : public A {
+
+  using traits = std::allocator_traits<A>;
+
+  public:
+
+    template <typename U>
+    struct rebind {
+      using other = DefaultInitAllocator<U, typename traits::template rebind_alloc<U>>;
+    };
+
+    using A::A;
+
+    DefaultInitAllocator() = default;
+
+    template <typename U, typename B>
+    DefaultInitAllocator(const DefaultInitAllocator<U, B>& rhs) noexcept : A(static_cast<const B&>(rhs)) {}
+
+    template <typename U>
+    void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>) {
+      ::new(static_cast<void*>(ptr)) U;
     }
-    return sz;
-  }
-  // enum
-  else if constexpr(std::is_enum_v<U>) {
-    return _save(static_cast<std::underlying_type_t<U>>(t));
-  }
-  // std::array
-  else if constexpr(is_std_array_v<U>) {
-    static_assert(std::tuple_size<U>::value > 0, "Array size can't be zero");
 
-    if constexpr(std::is_arithmetic_v<typename U::value_type>) {
-      _device.write(reinterpret_cast<const char*>(t.data()), sizeof(t));
-      return sizeof(t);
-    } 
-    else {
-      SizeType sz {0};
-      for(auto&& item : t) {
-        sz += _save(item);
-      }
-      return sz;
+    template <typename U, typename... ArgsT>
+    void construct(U* ptr, ArgsT&&... args) {
+      traits::construct(static_cast<A&>(*this), ptr, std::forward<ArgsT>(args)...);
     }
+};
+
+// is_default_init_allocator
+template <typename T>
+struct is_default_init_allocator : std::false_type {};
+
+template <typename T, typename A>
+struct is_default_init_allocator <DefaultInitAllocator<T, A>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_default_init_allocator_v = is_default_init_allocator<T>::value;
+
+// Function: make_using_allocator
+// Creates a T by uses-allocator construction: allocator-aware types that 
+// accept the allocator, leading or trailing, are constructed with it and 
+// other types are value-initialized. This is std::make_obj_using_allocator
+// of C++20 without the std::pair special case.
+template <typename T, typename A>
+T make_using_allocator(const A& alloc) {
+  if constexpr(std::uses_allocator_v<T, A> && std::is_constructible_v<T, std::allocator_arg_t, const A&>) {
+    return T(std::allocator_arg, alloc);
   }
-  // std::variant
-  else if constexpr(is_std_variant_v<U>) {
-    return _save(t.index()) + 
-           std::visit([&] (auto&& arg){ return _save(arg);}, t);
-  }
-  // std::duration
-  else if constexpr(is_std_duration_v<U>) {
-    return _save(t.count());
-  }
-  // std::time_point
-  else if constexpr(is_std_time_point_v<U>) {
-    return _save(t.time_since_epoch());
+  else if constexpr(std::uses_allocator_v<T, A> && std::is_constructible_v<T, const A&>) {
+    return T(alloc);
   }
-  // std::optional
-  else if constexpr(is_std_optional_v<U>) {
-    if(bool flag = t.has_value(); flag) {
-      return _save(flag) + _save(*t);
-    }
-    else {
-      return _save(flag);
-    }
+  else {
+    return T();
   }
-  // std::tuple
-  else if constexpr(is_std_tuple_v<U>) {
-    return std::apply(
-      [this] (auto&&... args) {
-        return (_save(std::forward<decltype(args)>(args)) + ... + 0); 
-      },
-      std::forward<T>(t)
+}
+
+// Function: make_scratch
+// Creates a T for scratch storage that may outlive the containers it is 
+// used with. std::pmr types allocate from the new-delete resource, which 
+// lives for the whole program, rather than from the current default.
+template <typename T>
+T make_scratch() {
+#ifdef CIRI_PMR
+  if constexpr(std::uses_allocator_v<T, std::pmr::polymorphic_allocator<std::byte>>) {
+    return make_using_allocator<T>(
+      std::pmr::polymorphic_allocator<std::byte>(std::pmr::new_delete_resource())
     );
   }
-  // Fall back to user-defined serialization method.
   else {
-    return t.save(*this);
+    return T();
   }
+#else
+  return T();
+#endif
 }
 
+// ----------------------------------------------------------------------------
+// Thread Pool
 // ----------------------------------------------------------------------------
 
-// Class: Deserializer
-template <typename Device = std::ostream, typename SizeType = std::streamsize>
-class Deserializer {
+// Class: ThreadPool
+// Set of persistent worker threads that run index loops with work stealing. 
+// Each worker, the calling thread being worker 0, owns a contiguous range 
+// of indices and takes grains from its front. A worker whose range runs dry 
+// steals the back half of another range, so uneven items still balance.
+// One loop runs at a time; concurrent callers wait for their turn.
+class ThreadPool {
 
   public:
-    
-    Deserializer(Device& device);
-    
-    template <typename... T>
-    SizeType operator()(T&&... items);
+
+    explicit ThreadPool(size_t num_workers = std::thread::hardware_concurrency()) : 
+      _num_workers {std::max(num_workers, size_t{1})},
+      _ranges {std::make_unique<Range[]>(_num_workers)} {
+      _threads.reserve(_num_workers - 1);
+      for(size_t w=1; w<_num_workers; ++w) {
+        _threads.emplace_back([this, w] () { _loop(w); });
+      }
+    }
+
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+      }
+      _work_cv.notify_all();
+      for(auto& thread : _threads) {
+        thread.join();
+      }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+
+    inline size_t num_workers() const { return _num_workers; }
+    
+    // Calls f(i, w) for every i in [0, n), where w < num_workers() identifies 
+    // the worker, and rethrows the first exception once all workers finish.
+    template <typename F>
+    void parallel_for(size_t n, size_t grain, F&& f) {
+
+      std::lock_guard<std::mutex> submit(_submit);
+
+      if(n == 0) {
+        return;
+      }
+      
+      for(size_t w=0; w<_num_workers; ++w) {
+        std::lock_guard<std::mutex> lock(_ranges[w].mutex);
+        _ranges[w].beg = n * w / _num_workers;
+        _ranges[w].end = n * (w + 1) / _num_workers;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task = [&f] (size_t i, size_t w) { f(i, w); };
+        _grain = std::max(grain, size_t{1});
+        _busy = _num_workers - 1;
+        _error = nullptr;
+        ++_generation;
+      }
+      _work_cv.notify_all();
+
+      _run(0);
+
+      std::unique_lock<std::mutex> lock(_mutex);
+      _done_cv.wait(lock, [this] () { return _busy == 0; });
+      _task = nullptr;
+
+      if(_error) {
+        std::rethrow_exception(std::exchange(_error, nullptr));
+      }
+    }
+
+  private:
+
+    struct alignas(64) Range {
+      std::mutex mutex;
+      size_t beg {0};
+      size_t end {0};
+    };
+
+    size_t _num_workers;
+    std::unique_ptr<Range[]> _ranges;
+    std::vector<std::thread> _threads;
+
+    std::mutex _submit;
+    std::mutex _mutex;
+    std::condition_variable _work_cv;
+    std::condition_variable _done_cv;
+    std::function<void(size_t, size_t)> _task;
+    std::exception_ptr _error;
+    size_t _grain {1};
+    size_t _busy {0};
+    size_t _generation {0};
+    bool _stop {false};
+
+    void _loop(size_t w) {
+      for(size_t seen=0;;) {
+        {
+          std::unique_lock<std::mutex> lock(_mutex);
+          _work_cv.wait(lock, [&] () { return _stop || _generation != seen; });
+          if(_stop) {
+            return;
+          }
+          seen = _generation;
+        }
+        _run(w);
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(--_busy == 0) {
+          _done_cv.notify_one();
+        }
+      }
+    }
+
+    void _run(size_t w) {
+      for(size_t beg, end; _pop(w, beg, end) || _steal(w, beg, end); ) {
+        try {
+          for(size_t i=beg; i<end; ++i) {
+            _task(i, w);
+          }
+        }
+        catch(...) {
+          {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if(!_error) {
+              _error = std::current_exception();
+            }
+          }
+          for(size_t v=0; v<_num_workers; ++v) {
+            std::lock_guard<std::mutex> lock(_ranges[v].mutex);
+            _ranges[v].beg = _ranges[v].end;
+          }
+        }
+      }
+    }
+
+    // Takes a grain from the front of the worker's own range.
+    bool _pop(size_t w, size_t& beg, size_t& end) {
+      std::lock_guard<std::mutex> lock(_ranges[w].mutex);
+      auto& range = _ranges[w];
+      if(range.beg == range.end) {
+        return false;
+      }
+      beg = range.beg;
+      end = range.beg + std::min(_grain, range.end - range.beg);
+      range.beg = end;
+      return true;
+    }
+    
+    // Takes the back half of the first non-empty range of another worker, 
+    // runs one grain of it, and keeps the rest as the worker's own range.
+    bool _steal(size_t w, size_t& beg, size_t& end) {
+      for(size_t k=1; k<_num_workers; ++k) {
+        auto& victim = _ranges[(w + k) % _num_workers];
+        size_t from, to;
+        {
+          std::lock_guard<std::mutex> lock(victim.mutex);
+          if(victim.beg == victim.end) {
+            continue;
+          }
+          to = victim.end;
+          from = to - (to - victim.beg + 1) / 2;
+          victim.end = from;
+        }
+        beg = from;
+        end = from + std::min(_grain, to - from);
+        std::lock_guard<std::mutex> lock(_ranges[w].mutex);
+        _ranges[w].beg = end;
+        _ranges[w].end = to;
+        return true;
+      }
+      return false;
+    }
+};
+
+// ----------------------------------------------------------------------------
+// Bulk Copy
+// ----------------------------------------------------------------------------
+
+// Smallest copy that memory devices split across the workers of a thread 
+// pool; smaller copies fit in cache and do not pay for the hand-off.
+inline constexpr size_t PARALLEL_COPY_SIZE = size_t{1} << 24;
+
+// Procedure: parallel_memcpy
+// Copies n bytes on the workers of the pool, the caller included, each 
+// taking a part of at least a quarter of PARALLEL_COPY_SIZE. The parts are 
+// copied with memcpy, which already switches to non-temporal stores for 
+// copies larger than the cache.
+inline void parallel_memcpy(char* dst, const char* src, size_t n, ThreadPool& pool) {
+
+  const size_t parts = std::clamp<size_t>(
+    n / (PARALLEL_COPY_SIZE / 4), 1, pool.num_workers()
+  );
+
+  if(parts == 1) {
+    std::memcpy(dst, src, n);
+    return;
+  }
+
+  const size_t part = ((n + parts - 1) / parts + 63) & ~size_t{63};
+
+  pool.parallel_for(parts, 1, [=] (size_t p, size_t) {
+    const size_t beg = std::min(p * part, n);
+    std::memcpy(dst + beg, src + beg, std::min(part, n - beg));
+  });
+}
+
+// ----------------------------------------------------------------------------
+// Memory Device
+// ----------------------------------------------------------------------------
+
+// Class: OutputBuffer
+// Output device that appends bytes to a contiguous in-memory buffer.
+class OutputBuffer {
+
+  public:
+
+    inline void write(const char* data, std::streamsize n) {
+      if(_pool && static_cast<size_t>(n) >= PARALLEL_COPY_SIZE) {
+        const size_t size = _bytes.size();
+        _bytes.resize(size + n);
+        parallel_memcpy(_bytes.data() + size, data, n, *_pool);
+      }
+      else {
+        _bytes.insert(_bytes.end(), data, data + n);
+      }
+    }
+
+    inline const char* data() const { return _bytes.data(); }
+    inline size_t size() const { return _bytes.size(); }
+    inline void clear() { _bytes.clear(); }
+    inline void reserve(size_t n) { _bytes.reserve(n); }
+
+    // Copies writes of at least PARALLEL_COPY_SIZE bytes on the workers of 
+    // the pool with parallel_memcpy; nullptr turns it off.
+    inline void parallel(ThreadPool* pool) { _pool = pool; }
+    inline ThreadPool* parallel() const { return _pool; }
+
+  private:
+
+    std::vector<char, DefaultInitAllocator<char>> _bytes;
+
+    ThreadPool* _pool {nullptr};
+};
+
+// Class: InputBuffer
+// Input device that reads bytes from a contiguous in-memory buffer it does not own.
+class InputBuffer {
+
+  public:
+
+    InputBuffer(const char* data, size_t size) : _cursor(data), _end(data + size) {}
+
+    inline void read(char* data, std::streamsize n) {
+      if(static_cast<size_t>(n) > remaining()) {
+        throw_error(std::errc::result_out_of_range, "ciri: read past the end of input buffer");
+      }
+      if(_pool && static_cast<size_t>(n) >= PARALLEL_COPY_SIZE) {
+        parallel_memcpy(data, _cursor, n, *_pool);
+        _cursor += n;
+      }
+      else if(n) {
+        std::memcpy(data, _cursor, n);
+        _cursor += n;
+      }
+    }
+
+    inline void ignore(std::streamsize n) {
+      if(static_cast<size_t>(n) > remaining()) {
+        throw_error(std::errc::result_out_of_range, "ciri: read past the end of input buffer");
+      }
+      _cursor += n;
+    }
+
+    // Function: view
+    // Consumes n bytes and returns a pointer to them inside the buffer.
+    inline const char* view(std::streamsize n) {
+      if(static_cast<size_t>(n) > remaining()) {
+        throw_error(std::errc::result_out_of_range, "ciri: read past the end of input buffer");
+      }
+      auto ptr = _cursor;
+      _cursor += n;
+      return ptr;
+    }
+
+    inline size_t remaining() const { return _end - _cursor; }
+
+    // Copies reads of at least PARALLEL_COPY_SIZE bytes on the workers of 
+    // the pool with parallel_memcpy; nullptr turns it off. Views are not 
+    // copied and are not affected, but the Deserializer reads such sizes 
+    // into vectors and strings instead of viewing them while a pool is set.
+    inline void parallel(ThreadPool* pool) { _pool = pool; }
+    inline ThreadPool* parallel() const { return _pool; }
+
+  private:
+
+    const char* _cursor;
+    const char* _end;
+
+    ThreadPool* _pool {nullptr};
+};
+
+// Class: ByteCounter
+// Output device that only counts the bytes written to it, used to measure 
+// an encoding before reserving space for it.
+class ByteCounter {
+
+  public:
+
+    inline void write(const char*, std::streamsize n) { _size += n; }
+
+    inline size_t size() const { return _size; }
+    inline void clear() { _size = 0; }
+
+  private:
+
+    size_t _size {0};
+};
+
+// ----------------------------------------------------------------------------
+// LZ Compression
+// ----------------------------------------------------------------------------
+
+// A byte-oriented LZ77 codec in the style of LZ4. A compressed block is a 
+// sequence of
+//
+//   token | literal length bytes | literals | offset | match length bytes
+//
+// where the token holds the literal length and the match length minus 4 in 
+// its high and low nibbles, a nibble of 15 continues with bytes of 255 until
+// a smaller byte, and the offset is a little-endian 16-bit distance back into
+// the already decoded output. The last sequence carries literals only.
+
+// Function: lz_bound
+// Returns the largest compressed size of n bytes.
+constexpr size_t lz_bound(size_t n) {
+  return n + n / 255 + 16;
+}
+
+// Function: lz_read32
+inline uint32_t lz_read32(const char* p) {
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+// Function: lz_hash
+inline uint32_t lz_hash(uint32_t v) {
+  return (v * 2654435761u) >> 20;
+}
+
+// Procedure: lz_write_length
+inline void lz_write_length(char*& dst, size_t len) {
+  for(; len >= 255; len -= 255) {
+    *dst++ = static_cast<char>(255);
+  }
+  *dst++ = static_cast<char>(len);
+}
+
+// Function: lz_compress
+// Compresses n bytes into dst, which must hold lz_bound(n) bytes, and returns
+// the compressed size. The table is scratch space of 4096 entries.
+inline size_t lz_compress(const char* src, size_t n, char* dst, uint32_t* table) {
+
+  constexpr size_t MIN_MATCH = 4;
+  constexpr size_t MAX_OFFSET = 65535;
+
+  char* out = dst;
+  size_t anchor = 0;
+
+  auto emit = [&] (size_t num_literals, size_t match_len, size_t offset) {
+    char* token = out++;
+    size_t lit_nibble = std::min<size_t>(num_literals, 15);
+    size_t match_nibble = match_len ? std::min<size_t>(match_len - MIN_MATCH, 15) : 0;
+    *token = static_cast<char>((lit_nibble << 4) | match_nibble);
+    if(lit_nibble == 15) {
+      lz_write_length(out, num_literals - 15);
+    }
+    std::memcpy(out, src + anchor, num_literals);
+    out += num_literals;
+    if(match_len) {
+      *out++ = static_cast<char>(offset & 0xFF);
+      *out++ = static_cast<char>(offset >> 8);
+      if(match_nibble == 15) {
+        lz_write_length(out, match_len - MIN_MATCH - 15);
+      }
+    }
+  };
+
+  if(n >= 16) {
+
+    std::fill(table, table + 4096, 0);
+
+    const size_t limit = n - 8;
+    size_t i = 0;
+    size_t misses = 0;
+
+    while(i < limit) {
+
+      uint32_t seq = lz_read32(src + i);
+      uint32_t h = lz_hash(seq);
+      size_t cand = table[h];
+      table[h] = static_cast<uint32_t>(i);
+
+      if(cand >= i || i - cand > MAX_OFFSET || lz_read32(src + cand) != seq) {
+        i += 1 + (misses++ >> 5);
+        continue;
+      }
+      misses = 0;
+
+      // extend the match eight bytes at a time
+      size_t len = MIN_MATCH;
+      while(true) {
+        if(i + len + 8 > n) {
+          while(i + len < n && src[i + len] == src[cand + len]) {
+            ++len;
+          }
+          break;
+        }
+        uint64_t a, b;
+        std::memcpy(&a, src + i + len, 8);
+        std::memcpy(&b, src + cand + len, 8);
+        if(a != b) {
+          len += countr_zero(a ^ b) >> 3;
+          break;
+        }
+        len += 8;
+      }
+
+      emit(i - anchor, len, i - cand);
+      i += len;
+      anchor = i;
+      
+      if(i < limit) {
+        table[lz_hash(lz_read32(src + i - 2))] = static_cast<uint32_t>(i - 2);
+      }
+    }
+  }
+
+  emit(n - anchor, 0, 0);
+
+  return out - dst;
+}
+
+// Function: lz_read_length
+inline bool lz_read_length(const char*& src, const char* end, size_t& len) {
+  uint8_t byte;
+  do {
+    if(src == end) {
+      return false;
+    }
+    byte = static_cast<uint8_t>(*src++);
+    len += byte;
+  } while(byte == 255);
+  return true;
+}
+
+// Function: lz_decompress
+// Decompresses m bytes into exactly n bytes. Returns false on malformed input.
+inline bool lz_decompress(const char* src, size_t m, char* dst, size_t n) {
+
+  const char* end = src + m;
+  char* out = dst;
+  char* out_end = dst + n;
+
+  while(src < end) {
+
+    uint8_t token = static_cast<uint8_t>(*src++);
+
+    size_t num_literals = token >> 4;
+    if(num_literals == 15 && !lz_read_length(src, end, num_literals)) {
+      return false;
+    }
+    if(num_literals > static_cast<size_t>(end - src) || num_literals > static_cast<size_t>(out_end - out)) {
+      return false;
+    }
+    std::memcpy(out, src, num_literals);
+    out += num_literals;
+    src += num_literals;
+
+    if(src == end) {
+      break;
+    }
+
+    if(end - src < 2) {
+      return false;
+    }
+    size_t offset = static_cast<uint8_t>(src[0]) | (static_cast<size_t>(static_cast<uint8_t>(src[1])) << 8);
+    src += 2;
+
+    size_t len = token & 15;
+    if(len == 15 && !lz_read_length(src, end, len)) {
+      return false;
+    }
+    len += 4;
+
+    if(offset == 0 || offset > static_cast<size_t>(out - dst) || len > static_cast<size_t>(out_end - out)) {
+      return false;
+    }
+
+    const char* match = out - offset;
+    if(offset >= 8) {
+      // non-overlapping 8-byte steps, the last one finished byte by byte
+      size_t k = 0;
+      for(; k + 8 <= len; k += 8) {
+        std::memcpy(out + k, match + k, 8);
+      }
+      for(; k < len; ++k) {
+        out[k] = match[k];
+      }
+    }
+    else {
+      for(size_t k=0; k<len; ++k) {
+        out[k] = match[k];
+      }
+    }
+    out += len;
+  }
+
+  return out == out_end;
+}
+
+// ----------------------------------------------------------------------------
+// Compression Device
+// ----------------------------------------------------------------------------
+
+// Class: CompressedOutput
+// Output device that compresses fixed-size blocks with lz_compress before 
+// writing them to the wrapped device. Every block starts with a header of its 
+// raw size and stored size as 32-bit integers, so readers can skip blocks or 
+// decode them independently. Blocks that do not shrink are stored as they 
+// are, with the stored size equal to the raw size. The block size is clamped 
+// to MAX_BLOCK_SIZE, the default limit of CompressedInput.
+template <typename Device>
+class CompressedOutput {
+
+  public:
+
+    static constexpr size_t HEADER_SIZE = 2 * sizeof(uint32_t);
+    static constexpr size_t MAX_BLOCK_SIZE = 1 << 26;
+
+    CompressedOutput(Device& device, size_t block_size = 1 << 16);
+
+    ~CompressedOutput();
+
+    void write(const char*, std::streamsize);
+
+    // Procedure: flush
+    // Compresses and writes the pending partial block. The destructor flushes
+    // as well, but swallows errors of the wrapped device.
+    void flush();
+    
+    // Procedure: compress
+    // Frames the n bytes as one compressed block appended to the output.
+    static void compress(const char*, size_t, std::vector<char>&, uint32_t*);
+
+  private:
+
+    Device& _device;
+
+    size_t _block_size;
+
+    std::vector<char> _block;
+    std::vector<char> _frame;
+    std::unique_ptr<uint32_t[]> _table;
+};
+
+// Constructor
+template <typename Device>
+CompressedOutput<Device>::CompressedOutput(Device& device, size_t block_size) : 
+  _device(device), 
+  _block_size(std::clamp<size_t>(block_size, 1, MAX_BLOCK_SIZE)),
+  _table(new uint32_t[4096]) {
+  _block.reserve(_block_size);
+}
+
+// Destructor
+template <typename Device>
+CompressedOutput<Device>::~CompressedOutput() {
+  try {
+    flush();
+  }
+  catch(...) {
+  }
+}
+
+// Procedure: write
+template <typename Device>
+void CompressedOutput<Device>::write(const char* data, std::streamsize n) {
+  while(n > 0) {
+    size_t k = std::min<size_t>(n, _block_size - _block.size());
+    _block.insert(_block.end(), data, data + k);
+    data += k;
+    n -= k;
+    if(_block.size() == _block_size) {
+      flush();
+    }
+  }
+}
+
+// Procedure: flush
+template <typename Device>
+void CompressedOutput<Device>::flush() {
+  if(_block.empty()) {
+    return;
+  }
+  _frame.clear();
+  compress(_block.data(), _block.size(), _frame, _table.get());
+  _device.write(_frame.data(), _frame.size());
+  _block.clear();
+}
+
+// Procedure: compress
+template <typename Device>
+void CompressedOutput<Device>::compress(
+  const char* data, size_t n, std::vector<char>& frame, uint32_t* table
+) {
+  
+  size_t beg = frame.size();
+  frame.resize(beg + HEADER_SIZE + lz_bound(n));
+
+  size_t m = lz_compress(data, n, frame.data() + beg + HEADER_SIZE, table);
+  if(m >= n) {
+    std::memcpy(frame.data() + beg + HEADER_SIZE, data, n);
+    m = n;
+  }
+
+  uint32_t header[2] = { static_cast<uint32_t>(n), static_cast<uint32_t>(m) };
+  std::memcpy(frame.data() + beg, header, HEADER_SIZE);
+
+  frame.resize(beg + HEADER_SIZE + m);
+}
+
+// Class: CompressedInput
+// Input device that reads and decompresses blocks written by CompressedOutput.
+// A block length above the given maximum is rejected before allocating.
+template <typename Device>
+class CompressedInput {
+
+  public:
+
+    static constexpr size_t HEADER_SIZE = CompressedOutput<Device>::HEADER_SIZE;
+
+    CompressedInput(Device& device, size_t max_block_size = CompressedOutput<Device>::MAX_BLOCK_SIZE);
+
+    void read(char*, std::streamsize);
+
+    // Function: decompress
+    // Decodes one block given its header fields. Returns false on malformed input.
+    static bool decompress(const char*, size_t, char*, size_t);
+
+  private:
+
+    Device& _device;
+
+    size_t _max_block_size;
+
+    std::vector<char> _block;
+    std::vector<char> _frame;
+
+    size_t _cursor {0};
+
+    void _next_block();
+};
+
+// Constructor
+template <typename Device>
+CompressedInput<Device>::CompressedInput(Device& device, size_t max_block_size) : 
+  _device(device), _max_block_size(max_block_size) {
+}
+
+// Procedure: read
+template <typename Device>
+void CompressedInput<Device>::read(char* data, std::streamsize n) {
+  while(n > 0) {
+    if(_cursor == _block.size()) {
+      _next_block();
+    }
+    size_t k = std::min<size_t>(n, _block.size() - _cursor);
+    std::memcpy(data, _block.data() + _cursor, k);
+    _cursor += k;
+    data += k;
+    n -= k;
+  }
+}
+
+// Procedure: _next_block
+template <typename Device>
+void CompressedInput<Device>::_next_block() {
+
+  uint32_t header[2];
+  _device.read(reinterpret_cast<char*>(header), HEADER_SIZE);
+  
+  if(header[0] == 0 || header[0] > _max_block_size || header[1] > lz_bound(header[0])) {
+    throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted compressed block header");
+  }
+
+  _frame.resize(header[1]);
+  _device.read(_frame.data(), header[1]);
+
+  _block.resize(header[0]);
+  if(!decompress(_frame.data(), header[1], _block.data(), header[0])) {
+    throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted compressed block");
+  }
+  _cursor = 0;
+}
+
+// Function: decompress
+template <typename Device>
+bool CompressedInput<Device>::decompress(const char* src, size_t m, char* dst, size_t n) {
+  if(m == n) {
+    std::memcpy(dst, src, n);
+    return true;
+  }
+  return lz_decompress(src, m, dst, n);
+}
+
+// ----------------------------------------------------------------------------
+// CRC32C
+// ----------------------------------------------------------------------------
+
+// The functions below operate on the raw CRC register of the reflected 
+// Castagnoli polynomial; crc32c applies the usual pre- and post-inversion.
+
+constexpr uint32_t CRC32C_POLY = 0x82F63B78;
+
+// Struct: Crc32cTable
+// Lookup tables for slicing-by-8.
+struct Crc32cTable {
+  uint32_t t[8][256] {};
+};
+
+// Function: make_crc32c_table
+constexpr Crc32cTable make_crc32c_table() {
+  Crc32cTable table;
+  for(uint32_t b=0; b<256; ++b) {
+    uint32_t crc = b;
+    for(int k=0; k<8; ++k) {
+      crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+    }
+    table.t[0][b] = crc;
+  }
+  for(uint32_t b=0; b<256; ++b) {
+    for(int k=1; k<8; ++k) {
+      table.t[k][b] = (table.t[k-1][b] >> 8) ^ table.t[0][table.t[k-1][b] & 0xFF];
+    }
+  }
+  return table;
+}
+
+inline constexpr Crc32cTable crc32c_table = make_crc32c_table();
+
+// Function: crc32c_sw
+// Software CRC32C update with slicing-by-8.
+inline uint32_t crc32c_sw(uint32_t crc, const char* data, size_t n) {
+  
+  const auto& t = crc32c_table.t;
+  auto p = reinterpret_cast<const uint8_t*>(data);
+
+  for(; n >= 8; n -= 8, p += 8) {
+    uint32_t lo, hi;
+    std::memcpy(&lo, p, 4);
+    std::memcpy(&hi, p + 4, 4);
+    lo ^= crc;
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+  }
+
+  for(; n; --n, ++p) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+  }
+
+  return crc;
+}
+
+// Function: crc32c_multiply
+// Multiplies two polynomials modulo the CRC polynomial (reflected).
+inline uint32_t crc32c_multiply(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31, p = 0;
+  for(; m; m >>= 1) {
+    if(a & m) {
+      p ^= b;
+    }
+    b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+  }
+  return p;
+}
+
+// Function: crc32c_xpow
+// Returns x^e modulo the CRC polynomial (reflected).
+inline uint32_t crc32c_xpow(uint64_t e) {
+  uint32_t p = 1u << 31;    // x^0
+  uint32_t sq = 1u << 30;   // x^1, x^2, x^4, ...
+  for(; e; e >>= 1) {
+    if(e & 1) {
+      p = crc32c_multiply(sq, p);
+    }
+    sq = crc32c_multiply(sq, sq);
+  }
+  return p;
+}
+
+// Function: crc32c_shift
+// Advances a CRC register over n zero bytes, which is what combining the
+// CRCs of two consecutive pieces takes: crc(A|B) = shift(crc(A), |B|) ^ crc(B).
+inline uint32_t crc32c_shift(uint32_t crc, size_t n) {
+  return crc32c_multiply(crc32c_xpow(8 * static_cast<uint64_t>(n)), crc);
+}
+
+#ifdef CIRI_CRC32C_HW_SUPPORTED
+// Function: crc32c_hw
+// CRC32C update with the SSE4.2 crc32 instruction. Large inputs run three 
+// independent streams to hide the instruction latency and fold the stream 
+// CRCs together with a carry-less multiplication (PCLMULQDQ).
+CIRI_CRC32C_HW inline uint32_t crc32c_hw(uint32_t crc, const char* data, size_t n) {
+
+  constexpr size_t L = 2048;
+
+  // x^(8L-33) and x^(16L-33): the shift by 8L (16L) bits after the 64-bit
+  // carry-less product is reduced by crc32 of a zero register
+  static const uint64_t k1 = crc32c_xpow(8 * L - 33);
+  static const uint64_t k2 = crc32c_xpow(16 * L - 33);
+
+  auto load = [] (const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+  };
+  
+  uint64_t c0 = crc;
+
+  for(; n >= 3 * L; n -= 3 * L, data += 3 * L) {
+    uint64_t c1 = 0, c2 = 0;
+    for(size_t i=0; i<L; i+=8) {
+      c0 = _mm_crc32_u64(c0, load(data + i));
+      c1 = _mm_crc32_u64(c1, load(data + L + i));
+      c2 = _mm_crc32_u64(c2, load(data + 2*L + i));
+    }
+    auto f0 = _mm_clmulepi64_si128(_mm_cvtsi64_si128(c0), _mm_cvtsi64_si128(k2), 0);
+    auto f1 = _mm_clmulepi64_si128(_mm_cvtsi64_si128(c1), _mm_cvtsi64_si128(k1), 0);
+    c0 = _mm_crc32_u64(0, _mm_cvtsi128_si64(_mm_xor_si128(f0, f1))) ^ c2;
+  }
+
+  for(; n >= 8; n -= 8, data += 8) {
+    c0 = _mm_crc32_u64(c0, load(data));
+  }
+
+  auto c = static_cast<uint32_t>(c0);
+  for(; n; --n, ++data) {
+    c = _mm_crc32_u8(c, static_cast<uint8_t>(*data));
+  }
+  
+  return c;
+}
+#endif
+
+// Function: crc32c
+// Computes the CRC-32C (Castagnoli) checksum of the bytes, continuing from 
+// the checksum of preceding bytes if given.
+inline uint32_t crc32c(const char* data, size_t n, uint32_t crc = 0) {
+#ifdef CIRI_CRC32C_HW_SUPPORTED
+  static const bool hw = CIRI_CRC32C_HW_SUPPORTED();
+  if(hw) {
+    return ~crc32c_hw(~crc, data, n);
+  }
+#endif
+  return ~crc32c_sw(~crc, data, n);
+}
+
+// ----------------------------------------------------------------------------
+// Checksum Device
+// ----------------------------------------------------------------------------
+
+// Class: ChecksumOutput
+// Output device that frames the bytes written to the wrapped device into 
+// blocks of a 32-bit length, a 32-bit CRC32C of the length and the payload,
+// and the payload. The block size is clamped to MAX_BLOCK_SIZE, the default 
+// limit of ChecksumInput.
+template <typename Device>
+class ChecksumOutput {
+
+  public:
+
+    static constexpr size_t HEADER_SIZE = 2 * sizeof(uint32_t);
+    static constexpr size_t MAX_BLOCK_SIZE = 1 << 26;
+
+    ChecksumOutput(Device& device, size_t block_size = 1 << 16);
+
+    ~ChecksumOutput();
+
+    void write(const char*, std::streamsize);
+
+    // Procedure: flush
+    // Writes the pending partial block. The destructor flushes as well, but 
+    // swallows errors of the wrapped device.
+    void flush();
+
+    // Procedure: frame
+    // Appends the n bytes as one framed block to the output.
+    static void frame(const char*, size_t, std::vector<char>&);
+
+  private:
+
+    Device& _device;
+
+    size_t _block_size;
+
+    std::vector<char> _frame;
+};
+
+// Constructor
+template <typename Device>
+ChecksumOutput<Device>::ChecksumOutput(Device& device, size_t block_size) : 
+  _device(device), 
+  _block_size(std::clamp<size_t>(block_size, 1, MAX_BLOCK_SIZE)) {
+  _frame.reserve(HEADER_SIZE + _block_size);
+  _frame.resize(HEADER_SIZE);
+}
+
+// Destructor
+template <typename Device>
+ChecksumOutput<Device>::~ChecksumOutput() {
+  try {
+    flush();
+  }
+  catch(...) {
+  }
+}
+
+// Procedure: write
+template <typename Device>
+void ChecksumOutput<Device>::write(const char* data, std::streamsize n) {
+  while(n > 0) {
+    size_t k = std::min<size_t>(n, HEADER_SIZE + _block_size - _frame.size());
+    _frame.insert(_frame.end(), data, data + k);
+    data += k;
+    n -= k;
+    if(_frame.size() == HEADER_SIZE + _block_size) {
+      flush();
+    }
+  }
+}
+
+// Procedure: flush
+template <typename Device>
+void ChecksumOutput<Device>::flush() {
+  
+  if(_frame.size() == HEADER_SIZE) {
+    return;
+  }
+
+  uint32_t header[2];
+  header[0] = static_cast<uint32_t>(_frame.size() - HEADER_SIZE);
+  header[1] = crc32c(_frame.data() + HEADER_SIZE, header[0], crc32c(reinterpret_cast<const char*>(header), 4));
+  std::memcpy(_frame.data(), header, HEADER_SIZE);
+
+  _device.write(_frame.data(), _frame.size());
+  _frame.resize(HEADER_SIZE);
+}
+
+// Procedure: frame
+template <typename Device>
+void ChecksumOutput<Device>::frame(const char* data, size_t n, std::vector<char>& out) {
+  uint32_t header[2];
+  header[0] = static_cast<uint32_t>(n);
+  header[1] = crc32c(data, n, crc32c(reinterpret_cast<const char*>(header), 4));
+  out.insert(out.end(), reinterpret_cast<const char*>(header), reinterpret_cast<const char*>(header) + HEADER_SIZE);
+  out.insert(out.end(), data, data + n);
+}
+
+// Class: ChecksumInput
+// Input device that reads blocks written by ChecksumOutput and verifies each 
+// block before any of its bytes are handed out. A length above the given 
+// maximum is rejected before allocating.
+template <typename Device>
+class ChecksumInput {
+
+  public:
+
+    static constexpr size_t HEADER_SIZE = ChecksumOutput<Device>::HEADER_SIZE;
+
+    ChecksumInput(Device& device, size_t max_block_size = ChecksumOutput<Device>::MAX_BLOCK_SIZE);
+
+    void read(char*, std::streamsize);
+
+  private:
+
+    Device& _device;
+
+    size_t _max_block_size;
+
+    std::vector<char> _block;
+
+    size_t _cursor {0};
+
+    void _next_block();
+};
+
+// Constructor
+template <typename Device>
+ChecksumInput<Device>::ChecksumInput(Device& device, size_t max_block_size) : 
+  _device(device), _max_block_size(max_block_size) {
+}
+
+// Procedure: read
+template <typename Device>
+void ChecksumInput<Device>::read(char* data, std::streamsize n) {
+  while(n > 0) {
+    if(_cursor == _block.size()) {
+      _next_block();
+    }
+    size_t k = std::min<size_t>(n, _block.size() - _cursor);
+    std::memcpy(data, _block.data() + _cursor, k);
+    _cursor += k;
+    data += k;
+    n -= k;
+  }
+}
+
+// Procedure: _next_block
+template <typename Device>
+void ChecksumInput<Device>::_next_block() {
+
+  uint32_t header[2];
+  _device.read(reinterpret_cast<char*>(header), HEADER_SIZE);
+
+  if(header[0] == 0 || header[0] > _max_block_size) {
+    throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted checksum block length");
+  }
+
+  _block.resize(header[0]);
+  _device.read(_block.data(), header[0]);
+
+  if(crc32c(_block.data(), header[0], crc32c(reinterpret_cast<const char*>(header), 4)) != header[1]) {
+    throw_error(std::errc::illegal_byte_sequence, "ciri: checksum mismatch");
+  }
+  _cursor = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Pipeline Device
+// ----------------------------------------------------------------------------
+
+// A pipeline moves blocks of bytes through a chain of stages, each on its 
+// own thread, so that encoding, transforms such as compression and checksums,
+// and device I/O run at the same time; its throughput approaches that of the 
+// slowest stage. Stages are connected by bounded single-producer 
+// single-consumer queues, on which idle threads sleep, and every queue has a 
+// second queue that returns consumed blocks upstream so their buffers are 
+// reused.
+
+// Stage of a pipeline: turns one input block into one output block, which 
+// is cleared beforehand; an empty output block is dropped and counts as 
+// completed.
+using PipelineStage = std::function<void(const std::vector<char>&, std::vector<char>&)>;
+
+// Class: BlockingQueue
+// Bounded queue between one producer thread and one consumer thread. Besides
+// the non-blocking try_push and try_pop, push and pop sleep on a condition 
+// variable until there is room or an item, or until the given stop flag is 
+// raised and wake is called.
+template <typename T>
+class BlockingQueue {
+
+  public:
+
+    explicit BlockingQueue(size_t capacity) : _slots(std::max(capacity, size_t{1})) {}
+    
+    // Moves the item in unless the queue is full.
+    bool try_push(T& item) {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_size == _slots.size()) {
+          return false;
+        }
+        _push(item);
+      }
+      _cv.notify_all();
+      return true;
+    }
+    
+    // Moves the front item out unless the queue is empty.
+    bool try_pop(T& item) {
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_size == 0) {
+          return false;
+        }
+        _pop(item);
+      }
+      _cv.notify_all();
+      return true;
+    }
+    
+    // Moves the item in once there is room. Returns false if stop is raised 
+    // while the queue is full.
+    bool push(T& item, const std::atomic<bool>& stop) {
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [&] () { 
+          return _size < _slots.size() || stop.load(std::memory_order_acquire); 
+        });
+        if(_size == _slots.size()) {
+          return false;
+        }
+        _push(item);
+      }
+      _cv.notify_all();
+      return true;
+    }
+    
+    // Moves the front item out once there is one. Returns false if stop is 
+    // raised while the queue is empty.
+    bool pop(T& item, const std::atomic<bool>& stop) {
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [&] () { 
+          return _size > 0 || stop.load(std::memory_order_acquire); 
+        });
+        if(_size == 0) {
+          return false;
+        }
+        _pop(item);
+      }
+      _cv.notify_all();
+      return true;
+    }
+
+    // Wakes the threads blocked in push or pop to recheck their stop flag, 
+    // which must be raised before.
+    void wake() {
+      { 
+        std::lock_guard<std::mutex> lock(_mutex); 
+      }
+      _cv.notify_all();
+    }
+
+  private:
+
+    std::vector<T> _slots;
+
+    size_t _head {0};
+    size_t _size {0};
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+
+    void _push(T& item) {
+      _slots[(_head + _size) % _slots.size()] = std::move(item);
+      ++_size;
+    }
+
+    void _pop(T& item) {
+      item = std::move(_slots[_head]);
+      _head = (_head + 1) % _slots.size();
+      --_size;
+    }
+};
+
+// Class: Pipeline
+// Chain of stage threads between one thread that pushes blocks and one 
+// thread that pops the processed blocks in the same order. An empty block 
+// pushed marks the end of the stream. The consumer reports each block it 
+// has finished through complete, and wait blocks until a number of blocks 
+// have been completed or dropped by a stage. The first exception thrown by 
+// a stage, or reported through fail, stops every thread and is kept for 
+// rethrow.
+class Pipeline {
+
+  public:
+
+    using Block = std::vector<char>;
+
+    Pipeline(std::vector<PipelineStage> stages, size_t depth);
+
+    ~Pipeline();
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator = (const Pipeline&) = delete;
+    
+    // Pushes the block, an empty one ending the stream, and replaces it with 
+    // a recycled buffer. Returns false if the pipeline has stopped.
+    bool push(Block&);
+    
+    // Recycles the block and replaces it with the next processed one. Returns 
+    // false at the end of the stream or if the pipeline has stopped.
+    bool pop(Block&);
+
+    // Counts one popped block as finished by the consumer.
+    void complete();
+
+    // Blocks until n blocks have been completed or dropped. Returns false if 
+    // the pipeline has stopped first.
+    bool wait(size_t n);
+
+    void fail(std::exception_ptr);
+
+    void rethrow();
+
+    inline bool failed() const { return _failed.load(std::memory_order_acquire); }
+
+  private:
+
+    std::vector<PipelineStage> _stages;
+    
+    // _queues[i] feeds stage i and _queues.back() the consumer, while 
+    // _recycled[i] returns their consumed blocks
+    std::vector<std::unique_ptr<BlockingQueue<Block>>> _queues;
+    std::vector<std::unique_ptr<BlockingQueue<Block>>> _recycled;
+
+    std::vector<std::thread> _threads;
+
+    std::atomic<bool> _failed {false};
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::exception_ptr _error;
+    size_t _completed {0};
+
+    bool _push(BlockingQueue<Block>&, Block&);
+    bool _pop(BlockingQueue<Block>&, Block&);
+    void _recycle(BlockingQueue<Block>&, Block&);
+    void _stop();
+    void _run(size_t);
+};
+
+// Constructor
+inline Pipeline::Pipeline(std::vector<PipelineStage> stages, size_t depth) : 
+  _stages(std::move(stages)) {
+  
+  depth = std::max(depth, size_t{1});
+
+  for(size_t i=0; i<=_stages.size(); ++i) {
+    _queues.push_back(std::make_unique<BlockingQueue<Block>>(depth));
+    _recycled.push_back(std::make_unique<BlockingQueue<Block>>(depth + 1));
+  }
+
+  _threads.reserve(_stages.size());
+  for(size_t i=0; i<_stages.size(); ++i) {
+    _threads.emplace_back([this, i] () { _run(i); });
+  }
+}
+
+// Destructor
+inline Pipeline::~Pipeline() {
+  _stop();
+  for(auto& thread : _threads) {
+    thread.join();
+  }
+}
+
+// Function: push
+inline bool Pipeline::push(Block& block) {
+  if(!_push(*_queues.front(), block)) {
+    return false;
+  }
+  if(!_recycled.front()->try_pop(block)) {
+    block = Block();
+  }
+  return true;
+}
+
+// Function: pop
+inline bool Pipeline::pop(Block& block) {
+  _recycle(*_recycled.back(), block);
+  return _pop(*_queues.back(), block) && !block.empty();
+}
+
+// Procedure: complete
+inline void Pipeline::complete() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_completed;
+  }
+  _cv.notify_all();
+}
+
+// Function: wait
+inline bool Pipeline::wait(size_t n) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _cv.wait(lock, [&] () { return _completed >= n || failed(); });
+  return _completed >= n;
+}
+
+// Procedure: fail
+inline void Pipeline::fail(std::exception_ptr error) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(!_error) {
+      _error = error;
+    }
+  }
+  _stop();
+}
+
+// Procedure: rethrow
+inline void Pipeline::rethrow() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if(_error) {
+    std::rethrow_exception(_error);
+  }
+}
+
+// Function: _push
+inline bool Pipeline::_push(BlockingQueue<Block>& queue, Block& block) {
+  return queue.push(block, _failed);
+}
+
+// Function: _pop
+inline bool Pipeline::_pop(BlockingQueue<Block>& queue, Block& block) {
+  return queue.pop(block, _failed);
+}
+
+// Procedure: _recycle
+// Returns the buffer upstream; it is dropped if the recycle queue is full.
+inline void Pipeline::_recycle(BlockingQueue<Block>& queue, Block& block) {
+  if(block.capacity()) {
+    block.clear();
+    queue.try_push(block);
+  }
+}
+
+// Procedure: _stop
+// Raises the stop flag and wakes every thread blocked on a queue or in wait.
+inline void Pipeline::_stop() {
+  _failed.store(true, std::memory_order_release);
+  for(auto& queue : _queues) {
+    queue->wake();
+  }
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+  }
+  _cv.notify_all();
+}
+
+// Procedure: _run
+inline void Pipeline::_run(size_t i) {
+  
+  Block in, out;
+
+  try {
+    while(_pop(*_queues[i], in)) {
+      if(in.empty()) {
+        _push(*_queues[i+1], in);
+        return;
+      }
+      if(!_recycled[i+1]->try_pop(out)) {
+        out = Block();
+      }
+      out.clear();
+      _stages[i](in, out);
+      if(out.empty()) {
+        complete();
+      }
+      else if(!_push(*_queues[i+1], out)) {
+        return;
+      }
+      _recycle(*_recycled[i], in);
+    }
+  }
+  catch(...) {
+    fail(std::current_exception());
+  }
+}
+
+// Class: PipelineOutput
+// Output device that cuts the bytes written into blocks of a fixed size and 
+// passes them through the stages to the wrapped device on a writer thread. 
+// Every block is written as a 32-bit byte count followed by the output of 
+// the last stage, and close writes a zero count to end the stream. The block
+// size is clamped to MAX_BLOCK_SIZE, and the stages may add at most 
+// MAX_STAGE_OVERHEAD bytes to a block, so the default PipelineInput accepts 
+// every block.
+template <typename Device>
+class PipelineOutput {
+
+  public:
+
+    static constexpr size_t MAX_BLOCK_SIZE = 1 << 26;
+    static constexpr size_t MAX_STAGE_OVERHEAD = 1 << 12;
+
+    PipelineOutput(
+      Device& device, 
+      std::vector<PipelineStage> stages = {}, 
+      size_t block_size = 1 << 16, 
+      size_t depth = 4
+    );
+    
+    // Closes the stream, but swallows errors.
+    ~PipelineOutput();
+
+    void write(const char*, std::streamsize);
+
+    // Procedure: flush
+    // Sends the pending partial block down the pipeline and blocks until the 
+    // wrapped device has received every block; rethrows the first error of 
+    // any stage or of the device.
+    void flush();
+    
+    // Procedure: close
+    // Flushes, writes the end of the stream, and stops the threads.
+    void close();
+
+  private:
+
+    Device& _device;
+
+    size_t _block_size;
+
+    Pipeline _pipeline;
+
+    std::vector<char> _block;
+
+    size_t _submitted {0};
+    bool _closed {false};
+
+    std::thread _writer;
+
+    void _submit();
+};
+
+// Constructor
+template <typename Device>
+PipelineOutput<Device>::PipelineOutput(
+  Device& device, std::vector<PipelineStage> stages, size_t block_size, size_t depth
+) : 
+  _device(device),
+  _block_size(std::clamp<size_t>(block_size, 1, MAX_BLOCK_SIZE)),
+  _pipeline(std::move(stages), depth) {
+  
+  _block.reserve(_block_size);
+
+  _writer = std::thread([this] () {
+    std::vector<char> block;
+    try {
+      while(_pipeline.pop(block)) {
+        if(block.size() > _block_size + MAX_STAGE_OVERHEAD) {
+          throw_error(std::errc::value_too_large, "ciri: pipeline stages exceed the block overhead");
+        }
+        uint32_t size = static_cast<uint32_t>(block.size());
+        _device.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        _device.write(block.data(), block.size());
+        _pipeline.complete();
+      }
+      if(!_pipeline.failed()) {
+        uint32_t size = 0;
+        _device.write(reinterpret_cast<const char*>(&size), sizeof(size));
+      }
+    }
+    catch(...) {
+      _pipeline.fail(std::current_exception());
+    }
+  });
+}
+
+// Destructor
+template <typename Device>
+PipelineOutput<Device>::~PipelineOutput() {
+  try {
+    close();
+  }
+  catch(...) {
+  }
+  if(_writer.joinable()) {
+    _pipeline.fail(nullptr);
+    _writer.join();
+  }
+}
+
+// Procedure: write
+template <typename Device>
+void PipelineOutput<Device>::write(const char* data, std::streamsize n) {
+  if(_closed) {
+    throw_error(std::errc::broken_pipe, "ciri: write to closed pipeline");
+  }
+  while(n > 0) {
+    size_t k = std::min<size_t>(n, _block_size - _block.size());
+    _block.insert(_block.end(), data, data + k);
+    data += k;
+    n -= k;
+    if(_block.size() == _block_size) {
+      _submit();
+    }
+  }
+}
+
+// Procedure: flush
+template <typename Device>
+void PipelineOutput<Device>::flush() {
+  if(!_block.empty()) {
+    _submit();
+  }
+  _pipeline.wait(_submitted);
+  _pipeline.rethrow();
+}
+
+// Procedure: close
+template <typename Device>
+void PipelineOutput<Device>::close() {
+  
+  if(_closed) {
+    return;
+  }
+
+  if(!_block.empty()) {
+    _submit();
+  }
+  _closed = true;
+
+  _block.clear();
+  _pipeline.push(_block);
+  _writer.join();
+  _pipeline.rethrow();
+}
+
+// Procedure: _submit
+template <typename Device>
+void PipelineOutput<Device>::_submit() {
+  if(!_pipeline.push(_block)) {
+    _pipeline.rethrow();
+    throw_error(std::errc::broken_pipe, "ciri: pipeline stopped");
+  }
+  ++_submitted;
+  _block.reserve(_block_size);
+}
+
+// Class: PipelineInput
+// Input device that reads the blocks of a PipelineOutput on a reader thread, 
+// ahead of the caller, and passes them through the stages, given in the 
+// order they undo the output stages. Reading stops at the end of the stream.
+// The limit is on the block size of the writer; a block read is rejected 
+// before allocating if it exceeds that plus the stage overhead.
+template <typename Device>
+class PipelineInput {
+
+  public:
+
+    PipelineInput(
+      Device& device, 
+      std::vector<PipelineStage> stages = {}, 
+      size_t max_block_size = PipelineOutput<Device>::MAX_BLOCK_SIZE, 
+      size_t depth = 4
+    );
+
+    ~PipelineInput();
+
+    void read(char*, std::streamsize);
+
+  private:
+
+    Device& _device;
+
+    size_t _max_block_size;
+
+    Pipeline _pipeline;
+
+    std::vector<char> _block;
+    size_t _cursor {0};
+    bool _ended {false};
+
+    std::thread _reader;
+};
+
+// Constructor
+template <typename Device>
+PipelineInput<Device>::PipelineInput(
+  Device& device, std::vector<PipelineStage> stages, size_t max_block_size, size_t depth
+) : 
+  _device(device),
+  _max_block_size(max_block_size),
+  _pipeline(std::move(stages), depth) {
+
+  _reader = std::thread([this] () {
+    std::vector<char> block;
+    try {
+      while(true) {
+        uint32_t size;
+        _device.read(reinterpret_cast<char*>(&size), sizeof(size));
+        if(size > _max_block_size + PipelineOutput<Device>::MAX_STAGE_OVERHEAD) {
+          throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted pipeline block length");
+        }
+        block.resize(size);
+        _device.read(block.data(), size);
+        if(!_pipeline.push(block) || size == 0) {
+          return;
+        }
+      }
+    }
+    catch(...) {
+      _pipeline.fail(std::current_exception());
+    }
+  });
+}
+
+// Destructor
+template <typename Device>
+PipelineInput<Device>::~PipelineInput() {
+  _pipeline.fail(nullptr);
+  _reader.join();
+}
+
+// Procedure: read
+template <typename Device>
+void PipelineInput<Device>::read(char* data, std::streamsize n) {
+  while(n > 0) {
+    if(_cursor == _block.size()) {
+      _cursor = 0;
+      if(_ended || !_pipeline.pop(_block)) {
+        _ended = true;
+        _block.clear();
+        _pipeline.rethrow();
+        throw_error(std::errc::result_out_of_range, "ciri: read past the end of pipeline");
+      }
+    }
+    size_t k = std::min<size_t>(n, _block.size() - _cursor);
+    std::memcpy(data, _block.data() + _cursor, k);
+    _cursor += k;
+    data += k;
+    n -= k;
+  }
+}
+
+// Function: compress_stage
+// Stage that compresses a block into the format of CompressedOutput.
+inline PipelineStage compress_stage() {
+  return [table = std::vector<uint32_t>(4096)] (const std::vector<char>& in, std::vector<char>& out) mutable {
+    CompressedOutput<OutputBuffer>::compress(in.data(), in.size(), out, table.data());
+  };
+}
+
+// Function: decompress_stage
+// Stage that undoes compress_stage.
+inline PipelineStage decompress_stage() {
+  return [] (const std::vector<char>& in, std::vector<char>& out) {
+    constexpr size_t HEADER_SIZE = CompressedOutput<OutputBuffer>::HEADER_SIZE;
+    uint32_t header[2] {0, 0};
+    if(in.size() >= HEADER_SIZE) {
+      std::memcpy(header, in.data(), HEADER_SIZE);
+    }
+    if(header[0] == 0 || header[1] > lz_bound(header[0]) || in.size() != HEADER_SIZE + header[1]) {
+      throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted compressed block header");
+    }
+    out.resize(header[0]);
+    if(!CompressedInput<InputBuffer>::decompress(in.data() + HEADER_SIZE, header[1], out.data(), header[0])) {
+      throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted compressed block");
+    }
+  };
+}
+
+// Function: checksum_stage
+// Stage that frames a block in the format of ChecksumOutput.
+inline PipelineStage checksum_stage() {
+  return [] (const std::vector<char>& in, std::vector<char>& out) {
+    ChecksumOutput<OutputBuffer>::frame(in.data(), in.size(), out);
+  };
+}
+
+// Function: verify_stage
+// Stage that verifies and unframes a block of checksum_stage.
+inline PipelineStage verify_stage() {
+  return [] (const std::vector<char>& in, std::vector<char>& out) {
+    constexpr size_t HEADER_SIZE = ChecksumOutput<OutputBuffer>::HEADER_SIZE;
+    uint32_t header[2] {0, 0};
+    if(in.size() >= HEADER_SIZE) {
+      std::memcpy(header, in.data(), HEADER_SIZE);
+    }
+    if(header[0] == 0 || in.size() != HEADER_SIZE + header[0]) {
+      throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted checksum block length");
+    }
+    if(crc32c(in.data() + HEADER_SIZE, header[0], crc32c(reinterpret_cast<const char*>(header), 4)) != header[1]) {
+      throw_error(std::errc::illegal_byte_sequence, "ciri: checksum mismatch");
+    }
+    out.assign(in.begin() + HEADER_SIZE, in.end());
+  };
+}
+
+// ----------------------------------------------------------------------------
+// Striped Device
+// ----------------------------------------------------------------------------
+
+// A striped archive spreads one byte stream over several shard devices, 
+// such as files on different drives, so that they are written and read at 
+// the same time. The stream is cut into stripes of a fixed size, stripe k 
+// goes to shard k % num_shards, and every shard has a thread of its own. 
+// The order follows from the manifest alone, which the caller saves 
+// alongside the shards.
+
+// Struct: StripeManifest
+// Layout of a striped archive.
+struct StripeManifest {
+
+  uint64_t stripe_size {0};
+  uint64_t size {0};
+  uint64_t num_shards {0};
+
+  template <typename ArchiverT>
+  auto save(ArchiverT& ar) const { return ar(stripe_size, size, num_shards); }
+
+  template <typename ArchiverT>
+  auto load(ArchiverT& ar) { return ar(stripe_size, size, num_shards); }
+};
+
+// Class: StripedOutput
+// Output device that writes stripes round-robin to the shard devices, each 
+// on a writer thread that sleeps on a bounded queue recycling its buffers.
+// The stripe size is clamped to MAX_STRIPE_SIZE, the default limit of 
+// StripedInput.
+template <typename Device>
+class StripedOutput {
+
+  public:
+
+    static constexpr size_t MAX_STRIPE_SIZE = 1 << 26;
+
+    StripedOutput(std::vector<Device>& shards, size_t stripe_size = 1 << 20, size_t depth = 4);
+    
+    // Closes the stream, but swallows errors.
+    ~StripedOutput();
+
+    void write(const char*, std::streamsize);
+
+    // Procedure: flush
+    // Blocks until every shard has received the full stripes sent so far, 
+    // and rethrows the first error of a shard. The partial stripe is kept,
+    // as only the last stripe may be short.
+    void flush();
+
+    // Procedure: close
+    // Sends the partial stripe, flushes, and stops the threads.
+    void close();
+    
+    // Function: manifest
+    // Returns the layout of the stripes written so far.
+    inline StripeManifest manifest() const { return {_stripe_size, _size, _shards.size()}; }
+
+  private:
+
+    using Block = std::vector<char>;
+
+    struct Shard {
+      BlockingQueue<Block> queue;
+      BlockingQueue<Block> recycled;
+      size_t written {0};
+      size_t submitted {0};
+      std::thread thread;
+      Shard(size_t depth) : queue(depth), recycled(depth + 1) {}
+    };
+
+    std::vector<Device>& _shards;
+
+    size_t _stripe_size;
+    uint64_t _size {0};
+    size_t _next {0};
+    bool _closed {false};
+
+    std::vector<std::unique_ptr<Shard>> _workers;
+
+    Block _block;
+
+    std::atomic<bool> _failed {false};
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::exception_ptr _error;
+
+    void _submit();
+    void _fail(std::exception_ptr);
+    void _stop();
+    void _rethrow();
+};
+
+// Constructor
+template <typename Device>
+StripedOutput<Device>::StripedOutput(std::vector<Device>& shards, size_t stripe_size, size_t depth) : 
+  _shards(shards), 
+  _stripe_size(std::clamp<size_t>(stripe_size, 1, MAX_STRIPE_SIZE)) {
+  
+  if(_shards.empty()) {
+    throw_error(std::errc::invalid_argument, "ciri: striped archive requires shards");
+  }
+
+  _block.reserve(_stripe_size);
+
+  for(size_t s=0; s<_shards.size(); ++s) {
+    _workers.push_back(std::make_unique<Shard>(std::max(depth, size_t{1})));
+  }
+
+  for(size_t s=0; s<_shards.size(); ++s) {
+    _workers[s]->thread = std::thread([this, s] () {
+      auto& worker = *_workers[s];
+      Block block;
+      try {
+        while(worker.queue.pop(block, _failed) && !block.empty()) {
+          _shards[s].write(block.data(), block.size());
+          block.clear();
+          worker.recycled.try_push(block);
+          {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ++worker.written;
+          }
+          _cv.notify_all();
+        }
+      }
+      catch(...) {
+        _fail(std::current_exception());
+      }
+    });
+  }
+}
+
+// Destructor
+template <typename Device>
+StripedOutput<Device>::~StripedOutput() {
+  try {
+    close();
+  }
+  catch(...) {
+  }
+  _stop();
+  for(auto& worker : _workers) {
+    if(worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+}
+
+// Procedure: write
+template <typename Device>
+void StripedOutput<Device>::write(const char* data, std::streamsize n) {
+  if(_closed) {
+    throw_error(std::errc::broken_pipe, "ciri: write to closed striped archive");
+  }
+  while(n > 0) {
+    size_t k = std::min<size_t>(n, _stripe_size - _block.size());
+    _block.insert(_block.end(), data, data + k);
+    data += k;
+    n -= k;
+    if(_block.size() == _stripe_size) {
+      _submit();
+    }
+  }
+}
+
+// Procedure: flush
+template <typename Device>
+void StripedOutput<Device>::flush() {
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this] () {
+      return _failed.load(std::memory_order_acquire) || std::all_of(
+        _workers.begin(), _workers.end(), [] (auto& w) { return w->written == w->submitted; }
+      );
+    });
+  }
+  _rethrow();
+}
+
+// Procedure: close
+template <typename Device>
+void StripedOutput<Device>::close() {
+
+  if(_closed) {
+    return;
+  }
+  _closed = true;
+
+  if(!_block.empty()) {
+    _submit();
+  }
+  flush();
+
+  for(auto& worker : _workers) {
+    Block end;
+    worker->queue.push(end, _failed);
+  }
+  for(auto& worker : _workers) {
+    worker->thread.join();
+  }
+  _rethrow();
+}
+
+// Procedure: _submit
+template <typename Device>
+void StripedOutput<Device>::_submit() {
+
+  auto& worker = *_workers[_next];
+  
+  const size_t size = _block.size();
+
+  if(!worker.queue.push(_block, _failed)) {
+    _rethrow();
+    throw_error(std::errc::broken_pipe, "ciri: striped archive stopped");
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++worker.submitted;
+  }
+  _size += size;
+  _next = (_next + 1) % _workers.size();
+
+  auto& recycled = _workers[_next]->recycled;
+  if(!recycled.try_pop(_block)) {
+    _block = Block();
+  }
+  _block.clear();
+  _block.reserve(_stripe_size);
+}
+
+// Procedure: _fail
+template <typename Device>
+void StripedOutput<Device>::_fail(std::exception_ptr error) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(!_error) {
+      _error = error;
+    }
+  }
+  _stop();
+}
+
+// Procedure: _stop
+// Raises the stop flag and wakes every thread blocked on a queue or in flush.
+template <typename Device>
+void StripedOutput<Device>::_stop() {
+  _failed.store(true, std::memory_order_release);
+  for(auto& worker : _workers) {
+    worker->queue.wake();
+  }
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+  }
+  _cv.notify_all();
+}
+
+// Procedure: _rethrow
+template <typename Device>
+void StripedOutput<Device>::_rethrow() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if(_error) {
+    std::rethrow_exception(_error);
+  }
+}
+
+// Class: StripedInput
+// Input device that reads the stripes of a StripedOutput ahead of the 
+// caller, each shard on a reader thread, and hands them out in order. A 
+// manifest whose stripe size is above the given maximum is rejected before
+// allocating.
+template <typename Device>
+class StripedInput {
+
+  public:
+
+    StripedInput(
+      std::vector<Device>& shards, 
+      const StripeManifest& manifest, 
+      size_t max_stripe_size = StripedOutput<Device>::MAX_STRIPE_SIZE,
+      size_t depth = 4
+    );
+
+    ~StripedInput();
+
+    void read(char*, std::streamsize);
+
+  private:
+
+    using Block = std::vector<char>;
+
+    struct Shard {
+      BlockingQueue<Block> queue;
+      BlockingQueue<Block> recycled;
+      std::thread thread;
+      Shard(size_t depth) : queue(depth), recycled(depth + 1) {}
+    };
+
+    std::vector<Device>& _shards;
+
+    StripeManifest _manifest;
+
+    uint64_t _num_stripes;
+    uint64_t _next {0};
+
+    std::vector<std::unique_ptr<Shard>> _workers;
+
+    Block _block;
+    size_t _cursor {0};
+
+    std::atomic<bool> _failed {false};
+    std::mutex _mutex;
+    std::exception_ptr _error;
+
+    void _stop();
+};
+
+// Constructor
+template <typename Device>
+StripedInput<Device>::StripedInput(
+  std::vector<Device>& shards, const StripeManifest& manifest, size_t max_stripe_size, size_t depth
+) : 
+  _shards(shards), 
+  _manifest(manifest) {
+  
+  if(_manifest.num_shards != _shards.size() || _shards.empty()) {
+    throw_error(std::errc::invalid_argument, "ciri: striped archive shard count mismatch");
+  }
+  if((_manifest.stripe_size == 0 && _manifest.size != 0) || _manifest.stripe_size > max_stripe_size) {
+    throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted stripe manifest");
+  }
+
+  _num_stripes = _manifest.size ? (_manifest.size - 1) / _manifest.stripe_size + 1 : 0;
+
+  for(size_t s=0; s<_shards.size(); ++s) {
+    _workers.push_back(std::make_unique<Shard>(std::max(depth, size_t{1})));
+  }
+
+  for(size_t s=0; s<_shards.size(); ++s) {
+    _workers[s]->thread = std::thread([this, s] () {
+      auto& worker = *_workers[s];
+      Block block;
+      try {
+        for(uint64_t k=s; k<_num_stripes; k+=_shards.size()) {
+          if(!worker.recycled.try_pop(block)) {
+            block = Block();
+          }
+          block.resize(std::min(_manifest.stripe_size, _manifest.size - k * _manifest.stripe_size));
+          _shards[s].read(block.data(), block.size());
+          if(!worker.queue.push(block, _failed)) {
+            return;
+          }
+        }
+      }
+      catch(...) {
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          if(!_error) {
+            _error = std::current_exception();
+          }
+        }
+        _stop();
+      }
+    });
+  }
+}
+
+// Destructor
+template <typename Device>
+StripedInput<Device>::~StripedInput() {
+  _stop();
+  for(auto& worker : _workers) {
+    worker->thread.join();
+  }
+}
+
+// Procedure: read
+template <typename Device>
+void StripedInput<Device>::read(char* data, std::streamsize n) {
+  while(n > 0) {
+    if(_cursor == _block.size()) {
+      if(_next == _num_stripes) {
+        throw_error(std::errc::result_out_of_range, "ciri: read past the end of striped archive");
+      }
+      auto& worker = *_workers[_next % _workers.size()];
+      if(_block.capacity()) {
+        _block.clear();
+        _workers[(_next + _workers.size() - 1) % _workers.size()]->recycled.try_push(_block);
+      }
+      if(!worker.queue.pop(_block, _failed)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::rethrow_exception(_error);
+      }
+      ++_next;
+      _cursor = 0;
+    }
+    size_t k = std::min<size_t>(n, _block.size() - _cursor);
+    std::memcpy(data, _block.data() + _cursor, k);
+    _cursor += k;
+    data += k;
+    n -= k;
+  }
+}
+
+// Procedure: _stop
+// Raises the stop flag and wakes every reader blocked on a full queue and 
+// the caller blocked on an empty one.
+template <typename Device>
+void StripedInput<Device>::_stop() {
+  _failed.store(true, std::memory_order_release);
+  for(auto& worker : _workers) {
+    worker->queue.wake();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Columnar Wrapper
+// ----------------------------------------------------------------------------
+
+// Class: Columnar
+// Class that wraps a std::vector of user-defined structs to serialize it 
+// column by column, one column per field saved by the struct.
+template <typename T>
+class Columnar {
+
+  public:
+
+    using type = std::conditional_t<std::is_lvalue_reference_v<T>, T, std::decay_t<T>>;
+
+    Columnar(T&& item) : _item(std::forward<T>(item)) {}
+    
+    Columnar& operator = (const Columnar&) = delete;
+
+    inline const std::decay_t<T>& get() const { return _item; }
+    inline std::remove_reference_t<type>& get() { return _item; }
+
+  private:
+
+    type _item;
+};
+
+// Function: make_columnar
+template <typename T>
+Columnar<T> make_columnar(T&& t) {
+  static_assert(is_std_vector_v<std::decay_t<T>>, "Columnar layout requires std::vector");
+  return { std::forward<T>(t) };
+}
+
+// Class: Column
+// Class that wraps a std::vector to load a single column of a columnar archive.
+template <typename T>
+class Column {
+
+  public:
+
+    using type = std::conditional_t<std::is_lvalue_reference_v<T>, T, std::decay_t<T>>;
+
+    Column(size_t index, T&& item) : _index(index), _item(std::forward<T>(item)) {}
+    
+    Column& operator = (const Column&) = delete;
+
+    inline size_t index() const { return _index; }
+    inline std::remove_reference_t<type>& get() { return _item; }
+
+  private:
+
+    size_t _index;
+    type _item;
+};
+
+// Function: make_column
+template <typename T>
+Column<T> make_column(size_t index, T&& t) {
+  static_assert(is_std_vector_v<std::decay_t<T>>, "Column target must be std::vector");
+  return { index, std::forward<T>(t) };
+}
+
+// is_columnar
+template <typename T>
+struct is_columnar : std::false_type {};
+
+template <typename T>
+struct is_columnar <Columnar<T>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_columnar_v = is_columnar<T>::value;
+
+// is_column
+template <typename T>
+struct is_column : std::false_type {};
+
+template <typename T>
+struct is_column <Column<T>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_column_v = is_column<T>::value;
+
+// ----------------------------------------------------------------------------
+// Encoding Wrapper
+// ----------------------------------------------------------------------------
+
+// Enum: Encoding
+// Wire encodings of an arithmetic array. The tag is written ahead of the 
+// payload so the deserializer can dispatch on it.
+enum class Encoding : uint8_t {
+  RAW        = 0,
+  RLE        = 1,
+  VARINT     = 2,
+  DELTA      = 3,
+  FOR        = 4,
+  SHUFFLE    = 5,
+  BITSHUFFLE = 6,
+  FP16       = 7,   // lossy: IEEE half precision
+  BF16       = 8,   // lossy: bfloat16
+  INT8       = 9,   // lossy: 8-bit integers scaled per block of 256 values
+  ADAPTIVE   = 0xFF   // save-only: picks one of RAW, RLE, VARINT, DELTA, FOR
+};
+
+// Class: Encoded
+// Class that wraps a std::vector or std::array of arithmetic values to 
+// serialize it with the given encoding.
+template <typename T>
+class Encoded {
+
+  public:
+
+    using type = std::conditional_t<std::is_lvalue_reference_v<T>, T, std::decay_t<T>>;
+
+    Encoded(T&& item, Encoding encoding, float preference = 0.5f) : 
+      _item(std::forward<T>(item)), _encoding(encoding), _preference(preference) {}
+    
+    Encoded& operator = (const Encoded&) = delete;
+
+    inline Encoding encoding() const { return _encoding; }
+    inline float preference() const { return _preference; }
+    inline const std::decay_t<T>& get() const { return _item; }
+    inline std::remove_reference_t<type>& get() { return _item; }
+
+  private:
+
+    type _item;
+    Encoding _encoding;
+    float _preference;
+};
+
+// Function: make_encoded
+// The encoding only matters on save; loading always dispatches on the tag.
+// Integer codecs (VARINT, DELTA, FOR) fall back to RAW for other types.
+template <typename T>
+Encoded<T> make_encoded(T&& t, Encoding encoding = Encoding::RAW, float preference = 0.5f) {
+  using U = std::decay_t<T>;
+  static_assert(
+    (is_std_vector_v<U> || is_std_array_v<U>) && std::is_arithmetic_v<typename U::value_type>,
+    "Encoding requires std::vector or std::array of arithmetic values"
+  );
+  return { std::forward<T>(t), encoding, preference };
+}
+
+// Function: make_rle
+// Run-length encodes the array, falling back to raw when it would not shrink.
+template <typename T>
+Encoded<T> make_rle(T&& t) {
+  return make_encoded(std::forward<T>(t), Encoding::RLE);
+}
+
+// Function: make_shuffle
+// Groups the i-th bytes of all values together so that the slowly varying 
+// sign and exponent bytes of floating-point data form long similar runs for
+// a downstream compressing device. The size is unchanged.
+template <typename T>
+Encoded<T> make_shuffle(T&& t) {
+  return make_encoded(std::forward<T>(t), Encoding::SHUFFLE);
+}
+
+// Function: make_bitshuffle
+// Byte-shuffles the values and then groups the i-th bits of each byte plane.
+template <typename T>
+Encoded<T> make_bitshuffle(T&& t) {
+  return make_encoded(std::forward<T>(t), Encoding::BITSHUFFLE);
+}
+
+// Function: make_quantized
+// Stores floating-point values with reduced precision, one of FP16, BF16, or
+// INT8. Values load back as the original type but are not exact.
+template <typename T>
+Encoded<T> make_quantized(T&& t, Encoding encoding = Encoding::FP16) {
+  static_assert(
+    std::is_floating_point_v<typename std::decay_t<T>::value_type>, 
+    "Quantization requires floating-point values"
+  );
+  return make_encoded(std::forward<T>(t), encoding);
+}
+
+// Function: make_adaptive
+// Picks the encoding per array from sampled statistics. The preference 
+// ranges from 0 (favor decoding speed) to 1 (favor encoded size).
+template <typename T>
+Encoded<T> make_adaptive(T&& t, float preference = 0.5f) {
+  return make_encoded(std::forward<T>(t), Encoding::ADAPTIVE, preference);
+}
+
+// is_encoded
+template <typename T>
+struct is_encoded : std::false_type {};
+
+template <typename T>
+struct is_encoded <Encoded<T>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_encoded_v = is_encoded<T>::value;
+
+// ----------------------------------------------------------------------------
+// Bit-field Wrapper
+// ----------------------------------------------------------------------------
+
+// Class: Bits
+// Class that wraps a bool, enum, or integer to serialize its low N bits. 
+// Consecutive bit fields in one call of the archiver are packed LSB-first 
+// into 64-bit words; pending bits are flushed to whole bytes before the next 
+// non-bit item and at the end of the call.
+template <size_t N, typename T>
+class Bits {
+
+  public:
+
+    using type = std::conditional_t<std::is_lvalue_reference_v<T>, T, std::decay_t<T>>;
+
+    static constexpr size_t width = N;
+
+    Bits(T&& item) : _item(std::forward<T>(item)) {}
+    
+    Bits& operator = (const Bits&) = delete;
+
+    inline const std::decay_t<T>& get() const { return _item; }
+    inline std::remove_reference_t<type>& get() { return _item; }
+
+  private:
+
+    type _item;
+};
+
+// Function: make_bits
+template <size_t N, typename T>
+Bits<N, T> make_bits(T&& t) {
+  using U = std::decay_t<T>;
+  static_assert(std::is_integral_v<U> || std::is_enum_v<U>, "Bit fields require bool, enum, or integer");
+  static_assert(N >= 1 && N <= sizeof(U) * 8, "Bit width out of range");
+  return { std::forward<T>(t) };
+}
+
+// is_bits
+template <typename T>
+struct is_bits : std::false_type {};
+
+template <size_t N, typename T>
+struct is_bits <Bits<N, T>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_bits_v = is_bits<T>::value;
+
+// ----------------------------------------------------------------------------
+// Run-length coding
+// ----------------------------------------------------------------------------
+
+// Function: run_length
+// Returns the number of leading values bitwise equal to the first one.
+template <typename T>
+size_t run_length(const T* data, size_t n) {
+
+  size_t i = 1;
+
+#ifdef CIRI_SSE2
+  if constexpr(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8) {
+    
+    constexpr size_t W = 16 / sizeof(T);
+    
+    const __m128i pattern = simd_broadcast(data[0]);
+
+    for(i = 0; i + W <= n; i += W) {
+      auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+      auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern)));
+      if(mask != 0xFFFF) {
+        return i + countr_zero(~mask) / sizeof(T);
+      }
+    }
+    
+    if(i == 0) {
+      i = 1;
+    }
+  }
+#endif
+
+  for(; i < n && std::memcmp(data + i, data, sizeof(T)) == 0; ++i);
+
+  return i;
+}
+
+// Procedure: run_fill
+// Writes n copies of the value.
+template <typename T>
+void run_fill(T* data, size_t n, const T& value) {
+
+  size_t i = 0;
+
+#ifdef CIRI_SSE2
+  if constexpr(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8) {
+    
+    constexpr size_t W = 16 / sizeof(T);
+
+    const __m128i pattern = simd_broadcast(value);
+
+    for(; i + W <= n; i += W) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), pattern);
+    }
+  }
+#endif
+
+  std::fill(data + i, data + n, value);
+}
+
+// Function: rle_encode
+// Splits the array into runs of values and lengths. Returns false as soon as 
+// the encoded runs would take no less space than the raw array.
+template <typename T>
+bool rle_encode(const T* data, size_t n, std::vector<T>& values, std::vector<uint32_t>& lengths) {
+
+  const size_t budget = n * sizeof(T);
+  
+  size_t bytes = sizeof(size_t);
+
+  if(bytes >= budget) {
+    return false;
+  }
+
+  for(size_t i=0; i<n; ) {
+    
+    if((bytes += sizeof(T) + sizeof(uint32_t)) >= budget) {
+      return false;
+    }
+
+    auto len = std::min(run_length(data + i, n - i), size_t{UINT32_MAX});
+
+    values.push_back(data[i]);
+    lengths.push_back(static_cast<uint32_t>(len));
+
+    i += len;
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Integer coding
+// ----------------------------------------------------------------------------
+
+// is_integer_codable
+template <typename T>
+constexpr bool is_integer_codable_v = std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+// Function: zigzag_encode
+// Maps signed values of small magnitude to small unsigned values.
+template <typename T>
+uint64_t zigzag_encode(T v) {
+  using U = std::make_unsigned_t<T>;
+  if constexpr(std::is_signed_v<T>) {
+    return static_cast<U>(static_cast<U>(static_cast<U>(v) << 1) ^ static_cast<U>(v >> (sizeof(T)*8 - 1)));
+  }
+  else {
+    return v;
+  }
+}
+
+// Function: zigzag_decode
+template <typename T>
+T zigzag_decode(uint64_t v) {
+  using U = std::make_unsigned_t<T>;
+  if constexpr(std::is_signed_v<T>) {
+    auto x = static_cast<U>(v);
+    auto mag = static_cast<U>(x >> 1);
+    auto sign = static_cast<U>(static_cast<U>(0) - static_cast<U>(x & 1));
+    return static_cast<T>(static_cast<U>(mag ^ sign));
+  }
+  else {
+    return static_cast<T>(v);
+  }
+}
+
+// Function: varint_size
+inline size_t varint_size(uint64_t v) {
+  size_t n = 1;
+  for(; v >= 0x80; v >>= 7) {
+    ++n;
+  }
+  return n;
+}
+
+// Procedure: varint_write
+// Appends the LEB128 encoding of the value.
+inline void varint_write(uint64_t v, std::vector<uint8_t>& bytes) {
+  for(; v >= 0x80; v >>= 7) {
+    bytes.push_back(static_cast<uint8_t>(v | 0x80));
+  }
+  bytes.push_back(static_cast<uint8_t>(v));
+}
+
+// Function: varint_read
+// Decodes one LEB128 value and advances the cursor. Returns false on overrun.
+inline bool varint_read(const uint8_t*& cursor, const uint8_t* end, uint64_t& v) {
+  v = 0;
+  for(unsigned shift = 0; cursor != end && shift < 64; shift += 7) {
+    uint8_t byte = *cursor++;
+    v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if(!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Procedure: varint_encode
+// Appends the zigzag varint of every value, or of every difference to the 
+// previous value if delta is set.
+template <typename T>
+void varint_encode(const T* data, size_t n, bool delta, std::vector<uint8_t>& bytes) {
+  using U = std::make_unsigned_t<T>;
+  using S = std::make_signed_t<T>;
+  if(delta) {
+    U prev = 0;
+    for(size_t i=0; i<n; ++i) {
+      auto cur = static_cast<U>(data[i]);
+      varint_write(zigzag_encode(static_cast<S>(static_cast<U>(cur - prev))), bytes);
+      prev = cur;
+    }
+  }
+  else {
+    for(size_t i=0; i<n; ++i) {
+      varint_write(zigzag_encode(data[i]), bytes);
+    }
+  }
+}
+
+// Function: varint_decode
+// Decodes exactly n values from the bytes. Returns false on malformed input.
+template <typename T>
+bool varint_decode(const uint8_t* bytes, size_t num_bytes, T* data, size_t n, bool delta) {
+  using U = std::make_unsigned_t<T>;
+  using S = std::make_signed_t<T>;
+  const uint8_t* end = bytes + num_bytes;
+  U prev = 0;
+  for(size_t i=0; i<n; ++i) {
+    uint64_t v;
+    if(!varint_read(bytes, end, v)) {
+      return false;
+    }
+    if(delta) {
+      prev = static_cast<U>(prev + static_cast<U>(zigzag_decode<S>(v)));
+      data[i] = static_cast<T>(prev);
+    }
+    else {
+      data[i] = zigzag_decode<T>(v);
+    }
+  }
+  return bytes == end;
+}
+
+// Function: bit_width
+inline uint8_t bit_width(uint64_t x) {
+  uint8_t w = 0;
+  for(; x; x >>= 1) {
+    ++w;
+  }
+  return w;
+}
+
+// Procedure: for_encode
+// Frame-of-reference coding: stores the minimum and packs each offset from 
+// it into width bits, least significant bits first.
+template <typename T>
+void for_encode(const T* data, size_t n, T& base, uint8_t& width, std::vector<uint64_t>& words) {
+  
+  using U = std::make_unsigned_t<T>;
+
+  base = n ? *std::min_element(data, data + n) : T{0};
+  
+  U range = 0;
+  for(size_t i=0; i<n; ++i) {
+    range = std::max(range, static_cast<U>(static_cast<U>(data[i]) - static_cast<U>(base)));
+  }
+  width = bit_width(range);
+
+  words.assign((n * width + 63) / 64, 0);
+
+  for(size_t i=0, bit=0; i<n && width; ++i, bit += width) {
+    uint64_t offset = static_cast<U>(static_cast<U>(data[i]) - static_cast<U>(base));
+    size_t w = bit >> 6, s = bit & 63;
+    words[w] |= offset << s;
+    if(s + width > 64) {
+      words[w + 1] |= offset >> (64 - s);
+    }
+  }
+}
+
+// Procedure: for_decode
+template <typename T>
+void for_decode(const uint64_t* words, T base, uint8_t width, T* data, size_t n) {
+  
+  using U = std::make_unsigned_t<T>;
+
+  const uint64_t mask = width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+
+  for(size_t i=0, bit=0; i<n; ++i, bit += width) {
+    uint64_t offset = 0;
+    if(width) {
+      size_t w = bit >> 6, s = bit & 63;
+      offset = words[w] >> s;
+      if(s + width > 64) {
+        offset |= words[w + 1] << (64 - s);
+      }
+      offset &= mask;
+    }
+    data[i] = static_cast<T>(static_cast<U>(static_cast<U>(base) + static_cast<U>(offset)));
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Shuffle coding
+// ----------------------------------------------------------------------------
+
+#ifdef CIRI_SSE2
+// Procedure: simd_interleave
+// Interleaves the bytes of register i with register i + R/2. Viewing the byte
+// address across all R registers as (register, byte) bits, one pass rotates 
+// the address left by one bit, so repeated passes transpose the bytes.
+template <size_t R>
+inline void simd_interleave(__m128i (&regs)[R]) {
+  __m128i out[R];
+  for(size_t x=0; x<R/2; ++x) {
+    out[2*x]   = _mm_unpacklo_epi8(regs[x], regs[x + R/2]);
+    out[2*x+1] = _mm_unpackhi_epi8(regs[x], regs[x + R/2]);
+  }
+  for(size_t x=0; x<R; ++x) {
+    regs[x] = out[x];
+  }
+}
+#endif
+
+// Procedure: byte_shuffle
+// Writes byte b of value i to dst[b*n + i].
+template <size_t S>
+void byte_shuffle(const uint8_t* src, uint8_t* dst, size_t n) {
+
+  size_t i = 0;
+
+#ifdef CIRI_SSE2
+  if constexpr(S == 2 || S == 4 || S == 8) {
+    // 16 values per iteration: four passes rotate (value, byte) to (byte, value)
+    for(; i + 16 <= n; i += 16) {
+      __m128i regs[S];
+      for(size_t r=0; r<S; ++r) {
+        regs[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i*S + r*16));
+      }
+      for(size_t pass=0; pass<4; ++pass) {
+        simd_interleave(regs);
+      }
+      for(size_t b=0; b<S; ++b) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + b*n + i), regs[b]);
+      }
+    }
+  }
+#endif
+
+  for(; i<n; ++i) {
+    for(size_t b=0; b<S; ++b) {
+      dst[b*n + i] = src[i*S + b];
+    }
+  }
+}
+
+// Procedure: byte_unshuffle
+// Inverse of byte_shuffle.
+template <size_t S>
+void byte_unshuffle(const uint8_t* src, uint8_t* dst, size_t n) {
+
+  size_t i = 0;
+
+#ifdef CIRI_SSE2
+  if constexpr(S == 2 || S == 4 || S == 8) {
+    // log2(S) passes rotate (byte, value) back to (value, byte)
+    constexpr size_t passes = S == 2 ? 1 : (S == 4 ? 2 : 3);
+    for(; i + 16 <= n; i += 16) {
+      __m128i regs[S];
+      for(size_t b=0; b<S; ++b) {
+        regs[b] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + b*n + i));
+      }
+      for(size_t pass=0; pass<passes; ++pass) {
+        simd_interleave(regs);
+      }
+      for(size_t r=0; r<S; ++r) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i*S + r*16), regs[r]);
+      }
+    }
+  }
+#endif
+
+  for(; i<n; ++i) {
+    for(size_t b=0; b<S; ++b) {
+      dst[i*S + b] = src[b*n + i];
+    }
+  }
+}
+
+// Function: bit_transpose8
+// Transposes an 8x8 bit matrix whose row i is byte i of the word.
+inline uint64_t bit_transpose8(uint64_t x) {
+  uint64_t t;
+  t = (x ^ (x >> 7))  & 0x00AA00AA00AA00AAull; x = x ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull; x = x ^ t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull; x = x ^ t ^ (t << 28);
+  return x;
+}
+
+// Procedure: bit_shuffle
+// Writes bit k of byte 8m+i to bit i of dst[k*(n/8) + m]. The trailing n%8 
+// bytes are copied as they are.
+inline void bit_shuffle(const uint8_t* src, uint8_t* dst, size_t n) {
+
+  const size_t G = n / 8;
+
+  size_t m = 0;
+
+#if defined(CIRI_AVX2)
+  for(; m + 4 <= G; m += 4) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + m*8));
+    for(int k=7; k>=0; --k) {
+      auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+      std::memcpy(dst + k*G + m, &mask, 4);
+      v = _mm256_add_epi8(v, v);
+    }
+  }
+#elif defined(CIRI_SSE2)
+  for(; m + 2 <= G; m += 2) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + m*8));
+    for(int k=7; k>=0; --k) {
+      auto mask = static_cast<uint16_t>(_mm_movemask_epi8(v));
+      std::memcpy(dst + k*G + m, &mask, 2);
+      v = _mm_add_epi8(v, v);
+    }
+  }
+#endif
+
+  for(; m<G; ++m) {
+    uint64_t x;
+    std::memcpy(&x, src + m*8, 8);
+    x = bit_transpose8(x);
+    for(size_t k=0; k<8; ++k) {
+      dst[k*G + m] = static_cast<uint8_t>(x >> (8*k));
+    }
+  }
+
+  if(n > G*8) {
+    std::memcpy(dst + G*8, src + G*8, n - G*8);
+  }
+}
+
+// Procedure: bit_unshuffle
+// Inverse of bit_shuffle.
+inline void bit_unshuffle(const uint8_t* src, uint8_t* dst, size_t n) {
+
+  const size_t G = n / 8;
+
+  for(size_t m=0; m<G; ++m) {
+    uint64_t x = 0;
+    for(size_t k=0; k<8; ++k) {
+      x |= static_cast<uint64_t>(src[k*G + m]) << (8*k);
+    }
+    x = bit_transpose8(x);
+    std::memcpy(dst + m*8, &x, 8);
+  }
+
+  if(n > G*8) {
+    std::memcpy(dst + G*8, src + G*8, n - G*8);
+  }
+}
+
+// Procedure: shuffle_encode
+// Byte-shuffles n values into dst, then bit-shuffles each byte plane if 
+// requested. The scratch buffer must hold n*sizeof(T) bytes.
+template <typename T>
+void shuffle_encode(const T* data, size_t n, bool bits, uint8_t* dst, uint8_t* scratch) {
+  auto src = reinterpret_cast<const uint8_t*>(data);
+  if(!bits) {
+    byte_shuffle<sizeof(T)>(src, dst, n);
+    return;
+  }
+  byte_shuffle<sizeof(T)>(src, scratch, n);
+  for(size_t b=0; b<sizeof(T); ++b) {
+    bit_shuffle(scratch + b*n, dst + b*n, n);
+  }
+}
+
+// Procedure: shuffle_decode
+// Inverse of shuffle_encode. The source is used as scratch for bit shuffles.
+template <typename T>
+void shuffle_decode(uint8_t* src, size_t n, bool bits, T* data, uint8_t* scratch) {
+  if(bits) {
+    for(size_t b=0; b<sizeof(T); ++b) {
+      bit_unshuffle(src + b*n, scratch + b*n, n);
+    }
+    src = scratch;
+  }
+  byte_unshuffle<sizeof(T)>(src, reinterpret_cast<uint8_t*>(data), n);
+}
+
+// ----------------------------------------------------------------------------
+// Quantization
+// ----------------------------------------------------------------------------
+
+// Function: float_to_half
+// Converts to IEEE half precision, rounding to nearest even.
+inline uint16_t float_to_half(float f) {
+
+  constexpr uint32_t F32_INF = 255u << 23;
+  constexpr uint32_t F16_MAX = (127u + 16) << 23;
+  constexpr uint32_t DENORM_MAGIC = ((127u - 15) + (23 - 10) + 1) << 23;
+
+  uint32_t x;
+  std::memcpy(&x, &f, 4);
+
+  uint32_t sign = x & 0x80000000u;
+  x ^= sign;
+
+  uint16_t h;
+
+  if(x >= F16_MAX) {
+    h = x > F32_INF ? 0x7E00 : 0x7C00;
+  }
+  else if(x < (113u << 23)) {
+    // align the 10 mantissa bits at the bottom with a float addition, which 
+    // rounds to nearest even
+    float v, magic;
+    std::memcpy(&v, &x, 4);
+    std::memcpy(&magic, &DENORM_MAGIC, 4);
+    v += magic;
+    std::memcpy(&x, &v, 4);
+    h = static_cast<uint16_t>(x - DENORM_MAGIC);
+  }
+  else {
+    uint32_t mant_odd = (x >> 13) & 1;
+    x += (static_cast<uint32_t>(15 - 127) << 23) + 0xFFF + mant_odd;
+    h = static_cast<uint16_t>(x >> 13);
+  }
+
+  return h | static_cast<uint16_t>(sign >> 16);
+}
+
+// Function: half_to_float
+inline float half_to_float(uint16_t h) {
+
+  constexpr uint32_t SHIFTED_EXP = 0x7C00u << 13;
+  constexpr uint32_t MAGIC = 113u << 23;
+
+  uint32_t x = static_cast<uint32_t>(h & 0x7FFF) << 13;
+  uint32_t exp = x & SHIFTED_EXP;
+  x += (127u - 15) << 23;
+
+  if(exp == SHIFTED_EXP) {
+    x += (128u - 16) << 23;
+  }
+  else if(exp == 0) {
+    x += 1u << 23;
+    float v, magic;
+    std::memcpy(&v, &x, 4);
+    std::memcpy(&magic, &MAGIC, 4);
+    v -= magic;
+    std::memcpy(&x, &v, 4);
+  }
+
+  x |= static_cast<uint32_t>(h & 0x8000) << 16;
+
+  float f;
+  std::memcpy(&f, &x, 4);
+  return f;
+}
+
+#ifdef CIRI_F16C_HW_SUPPORTED
+// Procedure: fp16_encode_hw
+CIRI_F16C_HW inline void fp16_encode_hw(const float* src, size_t n, uint16_t* dst, size_t& i) {
+  for(; i + 8 <= n; i += 8) {
+    auto h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+  }
+}
+
+// Procedure: fp16_decode_hw
+CIRI_F16C_HW inline void fp16_decode_hw(const uint16_t* src, size_t n, float* dst, size_t& i) {
+  for(; i + 8 <= n; i += 8) {
+    auto h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+  }
+}
+#endif
+
+// Procedure: fp16_encode
+inline void fp16_encode(const float* src, size_t n, uint16_t* dst) {
+  size_t i = 0;
+#ifdef CIRI_F16C_HW_SUPPORTED
+  static const bool hw = CIRI_F16C_HW_SUPPORTED();
+  if(hw) {
+    fp16_encode_hw(src, n, dst, i);
+  }
+#endif
+  for(; i<n; ++i) {
+    dst[i] = float_to_half(src[i]);
+  }
+}
+
+// Procedure: fp16_decode
+inline void fp16_decode(const uint16_t* src, size_t n, float* dst) {
+  size_t i = 0;
+#ifdef CIRI_F16C_HW_SUPPORTED
+  static const bool hw = CIRI_F16C_HW_SUPPORTED();
+  if(hw) {
+    fp16_decode_hw(src, n, dst, i);
+  }
+#endif
+  for(; i<n; ++i) {
+    dst[i] = half_to_float(src[i]);
+  }
+}
+
+// Function: float_to_bf16
+// Keeps the upper 16 bits, rounding to nearest even and keeping NaNs quiet.
+inline uint16_t float_to_bf16(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, 4);
+  if((x & 0x7FFFFFFFu) > 0x7F800000u) {
+    return static_cast<uint16_t>((x >> 16) | 0x40);
+  }
+  x += 0x7FFF + ((x >> 16) & 1);
+  return static_cast<uint16_t>(x >> 16);
+}
+
+// Function: bf16_to_float
+inline float bf16_to_float(uint16_t h) {
+  uint32_t x = static_cast<uint32_t>(h) << 16;
+  float f;
+  std::memcpy(&f, &x, 4);
+  return f;
+}
+
+// Procedure: bf16_encode
+inline void bf16_encode(const float* src, size_t n, uint16_t* dst) {
+  size_t i = 0;
+#ifdef CIRI_SSE2
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i bias = _mm_set1_epi32(0x7FFF);
+  const __m128i quiet = _mm_set1_epi32(0x00400000);
+  for(; i + 8 <= n; i += 8) {
+    __m128i r[2];
+    for(int k=0; k<2; ++k) {
+      auto f = _mm_loadu_ps(src + i + 4*k);
+      auto x = _mm_castps_si128(f);
+      auto nan = _mm_castps_si128(_mm_cmpunord_ps(f, f));
+      auto rounded = _mm_add_epi32(x, _mm_add_epi32(bias, _mm_and_si128(_mm_srli_epi32(x, 16), one)));
+      x = _mm_or_si128(_mm_and_si128(nan, _mm_or_si128(x, quiet)), _mm_andnot_si128(nan, rounded));
+      // arithmetic shift keeps the upper half within int16 so the pack is exact
+      r[k] = _mm_srai_epi32(x, 16);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(r[0], r[1]));
+  }
+#endif
+  for(; i<n; ++i) {
+    dst[i] = float_to_bf16(src[i]);
+  }
+}
+
+// Procedure: bf16_decode
+inline void bf16_decode(const uint16_t* src, size_t n, float* dst) {
+  size_t i = 0;
+#ifdef CIRI_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  for(; i + 8 <= n; i += 8) {
+    auto h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(zero, h));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(zero, h));
+  }
+#endif
+  for(; i<n; ++i) {
+    dst[i] = bf16_to_float(src[i]);
+  }
+}
+
+// Procedure: int8_encode
+// Scales every block of 256 values by its largest finite magnitude over 127 
+// and rounds to the nearest integer. NaN maps to zero and infinities saturate.
+// A block without a finite nonzero value but with an infinity gets the scale 
+// FLT_MAX, so the infinities saturate to +-127 and decode to infinities.
+inline void int8_encode(const float* src, size_t n, float* scales, int8_t* dst) {
+
+  constexpr size_t B = 256;
+
+  for(size_t beg=0, b=0; beg<n; beg+=B, ++b) {
+    
+    const size_t end = std::min(beg + B, n);
+
+    float amax = 0.0f;
+    bool inf = false;
+    for(size_t i=beg; i<end; ++i) {
+      float a = std::fabs(src[i]);
+      if(a > std::numeric_limits<float>::max()) {
+        inf = true;
+      }
+      else if(a > amax) {
+        amax = a;
+      }
+    }
+
+    float scale = amax / 127.0f;
+    float inv = scale > 0.0f ? 1.0f / scale : 0.0f;
+    if(scale == 0.0f && inf) {
+      scale = std::numeric_limits<float>::max();
+      inv = 1.0f;
+    }
+    scales[b] = scale;
+
+    size_t i = beg;
+#ifdef CIRI_SSE2
+    const __m128 vinv = _mm_set1_ps(inv);
+    const __m128 lo = _mm_set1_ps(-127.0f);
+    const __m128 hi = _mm_set1_ps(127.0f);
+    for(; i + 16 <= end; i += 16) {
+      __m128i q[4];
+      for(int k=0; k<4; ++k) {
+        auto v = _mm_mul_ps(_mm_loadu_ps(src + i + 4*k), vinv);
+        // min/max return the second operand for NaN, so NaN goes to -127 
+        // here; mask it to zero afterwards
+        auto nan = _mm_cmpunord_ps(v, v);
+        v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+        v = _mm_andnot_ps(nan, v);
+        q[k] = _mm_cvtps_epi32(v);
+      }
+      auto q16a = _mm_packs_epi32(q[0], q[1]);
+      auto q16b = _mm_packs_epi32(q[2], q[3]);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi16(q16a, q16b));
+    }
+#endif
+    for(; i<end; ++i) {
+      float v = src[i] * inv;
+      v = std::isnan(v) ? 0.0f : std::clamp(v, -127.0f, 127.0f);
+      dst[i] = static_cast<int8_t>(std::nearbyint(v));
+    }
+  }
+}
+
+// Procedure: int8_decode
+inline void int8_decode(const float* scales, const int8_t* src, size_t n, float* dst) {
+
+  constexpr size_t B = 256;
+
+  for(size_t beg=0, b=0; beg<n; beg+=B, ++b) {
+
+    const size_t end = std::min(beg + B, n);
+    size_t i = beg;
+
+#ifdef CIRI_SSE2
+    const __m128 vscale = _mm_set1_ps(scales[b]);
+    for(; i + 16 <= end; i += 16) {
+      auto q8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      // sign-extend 8 -> 16 -> 32 bits with unpack and arithmetic shifts
+      auto q16lo = _mm_srai_epi16(_mm_unpacklo_epi8(q8, q8), 8);
+      auto q16hi = _mm_srai_epi16(_mm_unpackhi_epi8(q8, q8), 8);
+      __m128i q32[4] = {
+        _mm_srai_epi32(_mm_unpacklo_epi16(q16lo, q16lo), 16),
+        _mm_srai_epi32(_mm_unpackhi_epi16(q16lo, q16lo), 16),
+        _mm_srai_epi32(_mm_unpacklo_epi16(q16hi, q16hi), 16),
+        _mm_srai_epi32(_mm_unpackhi_epi16(q16hi, q16hi), 16)
+      };
+      for(int k=0; k<4; ++k) {
+        _mm_storeu_ps(dst + i + 4*k, _mm_mul_ps(_mm_cvtepi32_ps(q32[k]), vscale));
+      }
+    }
+#endif
+    for(; i<end; ++i) {
+      dst[i] = src[i] * scales[b];
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Adaptive coding
+// ----------------------------------------------------------------------------
+
+// Struct: ArrayStats
+// Statistics sampled from an arithmetic array to estimate encoded sizes.
+template <typename T>
+struct ArrayStats {
+  size_t num_samples {0};
+  size_t num_repeats {0};      // adjacent sampled values that are equal
+  size_t varint_bytes {0};     // zigzag varint bytes of the sampled values
+  size_t delta_bytes {0};      // zigzag varint bytes of the sampled differences
+  T min {0};
+  T max {0};
+};
+
+// Function: sample_stats
+// Samples up to 32 evenly spread blocks of 64 consecutive values so that runs 
+// and differences between neighbors are still visible in the sample.
+template <typename T>
+ArrayStats<T> sample_stats(const T* data, size_t n) {
+
+  constexpr size_t B = 64;
+  constexpr size_t K = 32;
+
+  ArrayStats<T> stats;
+
+  if(n == 0) {
+    return stats;
+  }
+
+  stats.min = stats.max = data[0];
+
+  auto visit = [&] (size_t beg, size_t end) {
+    for(size_t i=beg; i<end; ++i) {
+      ++stats.num_samples;
+      stats.min = std::min(stats.min, data[i]);
+      stats.max = std::max(stats.max, data[i]);
+      if(i > beg && std::memcmp(data + i, data + i - 1, sizeof(T)) == 0) {
+        ++stats.num_repeats;
+      }
+      if constexpr(is_integer_codable_v<T>) {
+        using U = std::make_unsigned_t<T>;
+        using S = std::make_signed_t<T>;
+        stats.varint_bytes += varint_size(zigzag_encode(data[i]));
+        if(i > beg) {
+          auto d = static_cast<U>(static_cast<U>(data[i]) - static_cast<U>(data[i-1]));
+          stats.delta_bytes += varint_size(zigzag_encode(static_cast<S>(d)));
+        }
+      }
+    }
+  };
+
+  if(n <= B * K) {
+    visit(0, n);
+  }
+  else {
+    for(size_t k=0; k<K; ++k) {
+      size_t beg = k * (n - B) / (K - 1);
+      visit(beg, beg + B);
+    }
+  }
+
+  return stats;
+}
+
+// Function: select_encoding
+// Estimates the encoded size of every applicable codec from sampled 
+// statistics and returns the one with the lowest score. The score weighs the 
+// size by the relative decoding cost of the codec; a preference of 1 ranks by 
+// size alone, while lower values require slower codecs to save more space.
+template <typename T>
+Encoding select_encoding(const T* data, size_t n, float preference) {
+
+  const double raw = static_cast<double>(n * sizeof(T));
+
+  if(n < 16) {
+    return Encoding::RAW;
+  }
+
+  auto stats = sample_stats(data, n);
+
+  const double penalty = 1.0 - std::clamp(preference, 0.0f, 1.0f);
+  const double samples = static_cast<double>(stats.num_samples);
+
+  Encoding best = Encoding::RAW;
+  double best_score = raw;
+
+  auto consider = [&] (Encoding encoding, double bytes, double cost) {
+    double score = bytes * (1.0 + penalty * cost);
+    if(score < best_score) {
+      best = encoding;
+      best_score = score;
+    }
+  };
+
+  // runs of equal values, each costing one value and one 32-bit length
+  double run_ratio = 1.0 - stats.num_repeats / samples;
+  consider(Encoding::RLE, sizeof(size_t) + n * run_ratio * (sizeof(T) + sizeof(uint32_t)), 0.25);
+
+  if constexpr(is_integer_codable_v<T>) {
+    using U = std::make_unsigned_t<T>;
+    auto range = static_cast<U>(static_cast<U>(stats.max) - static_cast<U>(stats.min));
+    consider(Encoding::FOR, sizeof(T) + 1 + n * (bit_width(range) + 1) / 8.0, 0.5);
+    consider(Encoding::VARINT, sizeof(size_t) + n * stats.varint_bytes / samples, 1.0);
+    consider(Encoding::DELTA, sizeof(size_t) + n * stats.delta_bytes / samples, 1.25);
+  }
+
+  return best;
+}
+
+// ----------------------------------------------------------------------------
+// Parallel
+// ----------------------------------------------------------------------------
+
+// Number of elements per chunk when the serializer splits a container 
+// across threads. It is fixed so that the output does not depend on the 
+// number of threads.
+inline constexpr size_t PARALLEL_CHUNK_SIZE = 16384;
+
+// Size tag bit that marks a container written in chunks
+inline constexpr size_t CHUNKED_SIZE_FLAG = size_t{1} << (sizeof(size_t) * 8 - 1);
+
+// Class: Sharded
+// Class that wraps a std::vector of std::unordered_map or std::unordered_set
+// shards to serialize them as one container. Loading routes every item to 
+// the shard given by shard_index, so the number of shards is chosen by the
+// loader and the format is the same as that of a single container.
+template <typename T>
+class Sharded {
+
+  public:
+
+    using type = std::conditional_t<std::is_lvalue_reference_v<T>, T, std::decay_t<T>>;
+
+    Sharded(T&& item) : _item(std::forward<T>(item)) {}
+    
+    Sharded& operator = (const Sharded&) = delete;
+
+    inline const std::decay_t<T>& get() const { return _item; }
+    inline std::remove_reference_t<type>& get() { return _item; }
+
+  private:
+
+    type _item;
+};
+
+// Function: make_sharded
+template <typename T>
+Sharded<T> make_sharded(T&& t) {
+  using U = std::decay_t<T>;
+  static_assert(
+    is_std_vector_v<U> && (
+      is_std_unordered_map_v<typename U::value_type> || 
+      is_std_unordered_set_v<typename U::value_type>
+    ),
+    "Sharding requires a std::vector of std::unordered_map or std::unordered_set"
+  );
+  return { std::forward<T>(t) };
+}
+
+// Function: shard_index
+// Returns the shard that holds the key.
+template <typename T>
+size_t shard_index(const std::vector<T>& shards, const typename T::key_type& key) {
+  return shards[0].hash_function()(key) % shards.size();
+}
+
+// SegmentItem: the decoded form of an item of an unordered container
+template <typename T, typename = void>
+struct SegmentItem {
+  using type = typename T::key_type;
+};
+
+template <typename T>
+struct SegmentItem <T, std::void_t<typename T::mapped_type>> {
+  using type = std::pair<typename T::key_type, typename T::mapped_type>;
+};
+
+template <typename T>
+using SegmentItem_t = typename SegmentItem<T>::type;
+
+// is_sharded
+template <typename T>
+struct is_sharded : std::false_type {};
+
+template <typename T>
+struct is_sharded <Sharded<T>> : std::true_type {};
+
+template <typename T>
+constexpr bool is_sharded_v = is_sharded<T>::value;
+
+// Class: ColumnWriter (defined in the columnar archiver section)
+template <typename SizeType>
+class ColumnWriter;
+
+// Class: ColumnReader (defined in the columnar archiver section)
+template <typename SizeType>
+class ColumnReader;
+
+// ----------------------------------------------------------------------------
+
+// Class: Serializer
+template <typename Device = std::ostream, typename SizeType = std::streamsize>
+class Serializer {
+
+  public:
+    
+    Serializer(Device& device);
+    
+    template <typename... T>
+    SizeType operator()(T&&... items);
+
+    // Parallel mode encodes the elements of large std::vector, std::deque, 
+    // and std::array on the workers of the pool, PARALLEL_CHUNK_SIZE 
+    // elements at a time; a null pool turns it off. Vectors and deques are then written as 
+    // length-prefixed chunks behind a size tag marked with CHUNKED_SIZE_FLAG,
+    // while arrays keep their usual layout. Large std::unordered_map and 
+    // std::unordered_set are written the same way as segments of about 
+    // PARALLEL_CHUNK_SIZE items, each covering a range of buckets and 
+    // prefixed with its item and byte counts. The bytes are the same for 
+    // any number of workers. The pool runs one loop at a time, so the 
+    // serializer must not be called from a loop of the same pool.
+    inline void parallel(ThreadPool* pool) { _pool = pool; }
+    inline ThreadPool* parallel() const { return _pool; }
+  
+  private:
+
+    Device& _device;
+
+    ThreadPool* _pool {nullptr};
+
+    uint64_t _bit_word {0};
+    size_t _bit_count {0};
+    
+    template <typename T>
+    SizeType _save(T&&);
+
+    template <typename T>
+    SizeType _save_item(T&&);
+
+    template <typename T>
+    SizeType _save_range(const T*, size_t);
+
+    template <typename T>
+    SizeType _save_chunks(const T&, bool);
+
+    template <typename T>
+    SizeType _save_segments(const T*, size_t);
+
+    SizeType _save_bits(uint64_t, size_t);
+    SizeType _flush_bits();
+
+    template <typename T>
+    SizeType _save_columnar(const T&);
+
+    template <typename T>
+    SizeType _save_optionals(const T*, size_t);
+
+    template <typename T>
+    SizeType _save_encoded(const T*, size_t, Encoding, float);
+
+    template <typename T>
+    SizeType _save_quantized(const T*, size_t, Encoding);
+};
+
+// Constructor
+template <typename Device, typename SizeType>
+Serializer<Device, SizeType>::Serializer(Device& device) : _device(device) {
+}
+
+// Operator ()
+template <typename Device, typename SizeType>
+template <typename... T>
+SizeType Serializer<Device, SizeType>::operator() (T&&... items) {
+  return (_save_item(std::forward<T>(items)) + ... + _flush_bits());
+}
+
+// Function: _save_item
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Serializer<Device, SizeType>::_save_item(T&& t) {
+  if constexpr(is_bits_v<std::decay_t<T>>) {
+    return _save(std::forward<T>(t));
+  }
+  else {
+    return _flush_bits() + _save(std::forward<T>(t));
+  }
+}
+
+// Function: _save_range
+// Writes a contiguous range with the wire format of std::vector: the size 
+// tag followed by the elements.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Serializer<Device, SizeType>::_save_range(const T* data, size_t n) {
+  
+  auto sz = _save(make_size_tag(n));
+  
+  if constexpr(std::is_arithmetic_v<T>) {
+    _device.write(reinterpret_cast<const char*>(data), n * sizeof(T));
+    return sz + n * sizeof(T);
+  }
+  else if constexpr(is_std_optional_v<T>) {
+    return sz + _save_optionals(data, n);
+  }
+  else {
+    for(size_t i=0; i<n; ++i) {
+      sz += _save(data[i]);
+    }
+    return sz;
+  }
+}
+
+// Function: _save_chunks
+// Encodes the elements chunk by chunk on the serializer's pool, a few 
+// chunks per worker at a time to bound the buffered bytes, and writes the 
+// chunks in order. Framed chunks carry the marked size tag and the chunk 
+// size up front and a byte count ahead of each chunk; unframed chunks are 
+// byte-identical to the sequential layout.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Serializer<Device, SizeType>::_save_chunks(const T& items, bool framed) {
+
+  const size_t n = items.size();
+  const size_t num_chunks = (n + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+  const size_t wave = _pool->num_workers() * 4;
+
+  SizeType sz {0};
+
+  if(framed) {
+    sz += _save(make_size_tag(n | CHUNKED_SIZE_FLAG));
+    sz += _save(static_cast<uint64_t>(PARALLEL_CHUNK_SIZE));
+  }
+
+  std::vector<OutputBuffer> buffers(std::min(wave, num_chunks));
+
+  for(size_t beg=0; beg<num_chunks; beg+=wave) {
+
+    const size_t end = std::min(beg + wave, num_chunks);
+
+    _pool->parallel_for(end - beg, 1, [&] (size_t c, size_t) {
+      auto& buffer = buffers[c];
+      buffer.clear();
+      Serializer<OutputBuffer, SizeType> ar(buffer);
+      const size_t first = (beg + c) * PARALLEL_CHUNK_SIZE;
+      const size_t last = std::min(first + PARALLEL_CHUNK_SIZE, n);
+      for(size_t i=first; i<last; ++i) {
+        ar(items[i]);
+      }
+    });
+
+    for(size_t c=0; c<end-beg; ++c) {
+      if(framed) {
+        sz += _save(static_cast<uint64_t>(buffers[c].size()));
+      }
+      _device.write(buffers[c].data(), buffers[c].size());
+      sz += buffers[c].size();
+    }
+  }
+
+  return sz;
+}
+
+// Function: _save_segments
+// Splits the buckets of each container into ranges of about 
+// PARALLEL_CHUNK_SIZE items, encodes the ranges on the serializer's pool,
+// and writes them in order as segments of an item count, a byte count, and
+// the items.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Serializer<Device, SizeType>::_save_segments(const T* containers, size_t num_containers) {
+
+  struct Segment {
+    const T* container;
+    size_t beg;
+    size_t end;
+  };
+
+  std::vector<Segment> segments;
+  size_t num_data = 0;
+  
+  for(size_t c=0; c<num_containers; ++c) {
+    auto& container = containers[c];
+    const size_t num_buckets = container.bucket_count();
+    const size_t num_ranges = std::min(
+      num_buckets, (container.size() + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE
+    );
+    for(size_t r=0; r<num_ranges; ++r) {
+      segments.push_back({&container, num_buckets * r / num_ranges, num_buckets * (r+1) / num_ranges});
+    }
+    num_data += container.size();
+  }
+
+  auto sz = _save(make_size_tag(num_data | CHUNKED_SIZE_FLAG));
+  sz += _save(static_cast<uint64_t>(segments.size()));
+
+  const size_t wave = _pool->num_workers() * 4;
+  std::vector<OutputBuffer> buffers(std::min(wave, segments.size()));
+  std::vector<uint64_t> counts(buffers.size());
+
+  for(size_t beg=0; beg<segments.size(); beg+=wave) {
+
+    const size_t end = std::min(beg + wave, segments.size());
+
+    _pool->parallel_for(end - beg, 1, [&] (size_t s, size_t) {
+      auto& segment = segments[beg + s];
+      auto& buffer = buffers[s];
+      buffer.clear();
+      counts[s] = 0;
+      Serializer<OutputBuffer, SizeType> ar(buffer);
+      for(size_t b=segment.beg; b<segment.end; ++b) {
+        for(auto itr = segment.container->begin(b); itr != segment.container->end(b); ++itr) {
+          if constexpr(is_std_unordered_map_v<T>) {
+            ar(make_kv_pair(itr->first, itr->second));
+          }
+          else {
+            ar(*itr);
+          }
+          ++counts[s];
+        }
+      }
+    });
+
+    for(size_t s=0; s<end-beg; ++s) {
+      sz += _save(counts[s]);
+      sz += _save(static_cast<uint64_t>(buffers[s].size()));
+      _device.write(buffers[s].data(), buffers[s].size());
+      sz += buffers[s].size();
+    }
+  }
+
+  return sz;
+}
+
+// Function: _save_bits
+// Appends the low n bits of the value and writes out every filled word.
+template <typename Device, typename SizeType>
+SizeType Serializer<Device, SizeType>::_save_bits(uint64_t value, size_t n) {
+
+  if(n < 64) {
+    value &= (uint64_t{1} << n) - 1;
+  }
+  
+  _bit_word |= value << _bit_count;
+
+  if(_bit_count + n < 64) {
+    _bit_count += n;
+    return 0;
+  }
+
+  char bytes[8];
+  for(size_t i=0; i<8; ++i) {
+    bytes[i] = static_cast<char>(_bit_word >> (8*i));
+  }
+  _device.write(bytes, 8);
+  
+  // the high bits that did not fit start the next word
+  size_t used = 64 - _bit_count;
+  _bit_word = used < 64 ? value >> used : 0;
+  _bit_count = n - used;
+  
+  return 8;
+}
+
+// Function: _flush_bits
+// Writes the pending bits as whole bytes, padding with zero bits.
+template <typename Device, typename SizeType>
+SizeType Serializer<Device, SizeType>::_flush_bits() {
+
+  if(_bit_count == 0) {
+    return 0;
+  }
+
+  const size_t num_bytes = (_bit_count + 7) / 8;
+  char bytes[8];
+  for(size_t i=0; i<num_bytes; ++i) {
+    bytes[i] = static_cast<char>(_bit_word >> (8*i));
+  }
+  _device.write(bytes, num_bytes);
+
+  _bit_word = 0;
+  _bit_count = 0;
+
+  return num_bytes;
+}
+
+// Function: _save
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Serializer<Device, SizeType>::_save(T&& t) {
+
+  using U = std::decay_t<T>;
+  
+  // C array, checked before the decay to a pointer
+  if constexpr(std::is_array_v<std::remove_reference_t<T>>) {
+    
+    return _save_range(std::data(t), std::extent_v<std::remove_reference_t<T>>);
+  }
+  // C string, written like std::basic_string up to but excluding the 
+  // terminator
+  else if constexpr(std::is_pointer_v<U> && is_character_v<std::remove_pointer_t<U>>) {
+    if(t == nullptr) {
+      throw_error(std::errc::invalid_argument, "ciri: null C string");
+    }
+    return _save_range(t, std::char_traits<std::remove_cv_t<std::remove_pointer_t<U>>>::length(t));
+  }
+  // arithmetic data type
+  else if constexpr(std::is_arithmetic_v<U>) {
+    _device.write(reinterpret_cast<const char*>(std::addressof(t)), sizeof(t));
+    return sizeof(t);
+  }
+  // std::basic_string
+  else if constexpr(is_std_basic_string_v<U>) {
+    auto sz = _save(make_size_tag(t.size()));
+    _device.write(reinterpret_cast<const char*>(t.data()), t.size()*sizeof(typename U::value_type));
+    return sz + t.size()*sizeof(typename U::value_type);
+  }
+  // std::basic_string_view and spans, written like std::basic_string and 
+  // std::vector
+  else if constexpr(is_std_basic_string_view_v<U> || is_span_v<U>) {
+    return _save_range(t.data(), t.size());
+  }
+  // caller-provided storage
+  else if constexpr(is_into_v<U>) {
+    if(t.truncated()) {
+      throw_error(std::errc::invalid_argument, "ciri: size exceeds the capacity");
+    }
+    return _save_range(t.data(), t.size());
+  }
+  // std::vector
+  else if constexpr(is_std_vector_v<U>) {
+    if constexpr (std::is_arithmetic_v<typename U::value_type>) {
+      auto sz = _save(make_size_tag(t.size()));
+      _device.write(reinterpret_cast<const char*>(t.data()), t.size() * sizeof(typename U::value_type));
+      return sz + t.size() * sizeof(typename U::value_type);
+    } 
+    else if constexpr(is_std_optional_v<typename U::value_type>) {
+      return _save(make_size_tag(t.size())) + _save_optionals(t.data(), t.size());
+    }
+    else {
+      if(_pool && t.size() > PARALLEL_CHUNK_SIZE) {
+        return _save_chunks(t, true);
+      }
+      auto sz = _save(make_size_tag(t.size()));
+      for(auto&& item : t) {
+        sz += _save(item);
+      }
+      return sz;
+    }
+  }
+  // std::deque and std::list
+  else if constexpr(is_std_deque_v<U> || is_std_list_v<U>) {
+    if constexpr(is_std_deque_v<U>) {
+      if(_pool && t.size() > PARALLEL_CHUNK_SIZE) {
+        return _save_chunks(t, true);
+      }
+    }
+    auto sz = _save(make_size_tag(t.size()));
+    for(auto&& item : t) {
+      sz += _save(item);
+    }
+    return sz;
+  }
+  // std::forward_list
+  else if constexpr(is_std_forward_list_v<U>) {
+    auto sz = _save(make_size_tag(std::distance(t.begin(), t.end())));
+    for(auto&& item : t) {
+      sz += _save(item);
+    }
+    return sz;
+  }
+  // std::map and std::unordered_map
+  else if constexpr(is_std_map_v<U> || is_std_unordered_map_v<U>) {
+    if constexpr(is_std_unordered_map_v<U>) {
+      if(_pool && t.size() > PARALLEL_CHUNK_SIZE) {
+        return _save_segments(std::addressof(t), 1);
+      }
+    }
+    auto sz = _save(make_size_tag(t.size()));
+    for(auto&& [k, v] : t) {
+      sz += _save(make_kv_pair(k, v));
+    }
+    return sz;
+  }
+  // std::set and std::unordered_set
+  else if constexpr(is_std_set_v<U> || is_std_unordered_set_v<U>) {
+    if constexpr(is_std_unordered_set_v<U>) {
+      if(_pool && t.size() > PARALLEL_CHUNK_SIZE) {
+        return _save_segments(std::addressof(t), 1);
+      }
+    }
+    auto sz = _save(make_size_tag(t.size()));
+    for(auto&& item : t) {
+      sz += _save(item);
+    }
+    return sz;
+  }
+  // enum
+  else if constexpr(std::is_enum_v<U>) {
+    return _save(static_cast<std::underlying_type_t<U>>(t));
+  }
+  // std::array
+  else if constexpr(is_std_array_v<U>) {
+    static_assert(std::tuple_size<U>::value > 0, "Array size can't be zero");
+
+    if constexpr(std::is_arithmetic_v<typename U::value_type>) {
+      _device.write(reinterpret_cast<const char*>(t.data()), sizeof(t));
+      return sizeof(t);
+    } 
+    else if constexpr(is_std_optional_v<typename U::value_type>) {
+      return _save_optionals(t.data(), t.size());
+    }
+    else {
+      if(_pool && t.size() > PARALLEL_CHUNK_SIZE) {
+        return _save_chunks(t, false);
+      }
+      SizeType sz {0};
+      for(auto&& item : t) {
+        sz += _save(item);
+      }
+      return sz;
+    }
+  }
+  // std::variant
+  else if constexpr(is_std_variant_v<U>) {
+    return _save(t.index()) + 
+           std::visit([&] (auto&& arg){ return _save(arg);}, t);
+  }
+  // std::duration
+  else if constexpr(is_std_duration_v<U>) {
+    return _save(t.count());
+  }
+  // std::time_point
+  else if constexpr(is_std_time_point_v<U>) {
+    return _save(t.time_since_epoch());
+  }
+  // std::optional
+  else if constexpr(is_std_optional_v<U>) {
+    if(bool flag = t.has_value(); flag) {
+      return _save(flag) + _save(*t);
+    }
+    else {
+      return _save(flag);
+    }
+  }
+  // std::tuple
+  else if constexpr(is_std_tuple_v<U>) {
+    return std::apply(
+      [this] (auto&&... args) {
+        return (_save(std::forward<decltype(args)>(args)) + ... + 0); 
+      },
+      std::forward<T>(t)
+    );
+  }
+  // columnar std::vector
+  else if constexpr(is_columnar_v<U>) {
+    return _save_columnar(t.get());
+  }
+  // encoded std::vector and std::array
+  else if constexpr(is_encoded_v<U>) {
+    auto& items = t.get();
+    if constexpr(is_std_vector_v<std::decay_t<decltype(items)>>) {
+      return _save(make_size_tag(items.size())) + 
+             _save_encoded(items.data(), items.size(), t.encoding(), t.preference());
+    }
+    else {
+      return _save_encoded(items.data(), items.size(), t.encoding(), t.preference());
+    }
+  }
+  // sharded std::unordered_map and std::unordered_set, written as one
+  else if constexpr(is_sharded_v<U>) {
+    auto& shards = t.get();
+    size_t num_data = 0;
+    for(auto& shard : shards) {
+      num_data += shard.size();
+    }
+    if(_pool && num_data > PARALLEL_CHUNK_SIZE) {
+      return _save_segments(shards.data(), shards.size());
+    }
+    auto sz = _save(make_size_tag(num_data));
+    for(auto& shard : shards) {
+      for(auto&& item : shard) {
+        if constexpr(is_std_unordered_map_v<typename std::decay_t<decltype(shards)>::value_type>) {
+          sz += _save(make_kv_pair(item.first, item.second));
+        }
+        else {
+          sz += _save(item);
+        }
+      }
+    }
+    return sz;
+  }
+  // bit field
+  else if constexpr(is_bits_v<U>) {
+    using V = std::decay_t<decltype(t.get())>;
+    if constexpr(std::is_enum_v<V>) {
+      return _save_bits(static_cast<uint64_t>(static_cast<std::underlying_type_t<V>>(t.get())), U::width);
+    }
+    else {
+      return _save_bits(static_cast<uint64_t>(t.get()), U::width);
+    }
+  }
+  // Fall back to user-defined serialization method.
+  else {
+    return t.save(*this);
+  }
+}
+
+// Function: _save_optionals
+// Writes a packed validity bitmap followed by the present values, which are 
+// gathered into one contiguous block when arithmetic.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Serializer<Device, SizeType>::_save_optionals(const T* data, size_t n) {
+
+  using V = typename T::value_type;
+
+  // values are packed in a plain array since std::vector<bool> has no data()
+  std::vector<uint8_t> bitmap((n + 7) / 8, 0);
+  std::unique_ptr<V[]> values;
+  size_t num_values {0};
+
+  if constexpr(std::is_arithmetic_v<V>) {
+    values.reset(new V[n]);
+  }
+
+  for(size_t i=0; i<n; ++i) {
+    if(data[i]) {
+      bitmap[i >> 3] |= static_cast<uint8_t>(1u << (i & 7));
+      if constexpr(std::is_arithmetic_v<V>) {
+        values[num_values++] = *data[i];
+      }
+    }
+  }
+
+  _device.write(reinterpret_cast<const char*>(bitmap.data()), bitmap.size());
+  SizeType sz = bitmap.size();
+
+  if constexpr(std::is_arithmetic_v<V>) {
+    _device.write(reinterpret_cast<const char*>(values.get()), num_values * sizeof(V));
+    sz += num_values * sizeof(V);
+  }
+  else {
+    for(size_t i=0; i<n; ++i) {
+      if(data[i]) {
+        sz += _save(*data[i]);
+      }
+    }
+  }
+
+  return sz;
+}
+
+// Function: _save_encoded
+// Writes the encoding tag followed by the encoded payload. Any encoding that 
+// does not apply to the value type or would not beat the raw size is 
+// written as raw instead.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Serializer<Device, SizeType>::_save_encoded(
+  const T* data, size_t n, Encoding encoding, float preference
+) {
+
+  if(encoding == Encoding::ADAPTIVE) {
+    encoding = select_encoding(data, n, preference);
+  }
+
+  switch(encoding) {
+
+    case Encoding::RLE: {
+      std::vector<T> values;
+      std::vector<uint32_t> lengths;
+      if(rle_encode(data, n, values, lengths)) {
+        auto sz = _save(static_cast<uint8_t>(Encoding::RLE)) + _save(make_size_tag(values.size()));
+        _device.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        _device.write(reinterpret_cast<const char*>(lengths.data()), lengths.size() * sizeof(uint32_t));
+        return sz + values.size() * (sizeof(T) + sizeof(uint32_t));
+      }
+    }
+    break;
+
+    case Encoding::VARINT:
+    case Encoding::DELTA:
+      if constexpr(is_integer_codable_v<T>) {
+        std::vector<uint8_t> bytes;
+        varint_encode(data, n, encoding == Encoding::DELTA, bytes);
+        if(sizeof(size_t) + bytes.size() < n * sizeof(T)) {
+          auto sz = _save(static_cast<uint8_t>(encoding)) + _save(make_size_tag(bytes.size()));
+          _device.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+          return sz + bytes.size();
+        }
+      }
+    break;
+
+    case Encoding::SHUFFLE:
+    case Encoding::BITSHUFFLE: {
+      const bool bits = encoding == Encoding::BITSHUFFLE;
+      std::vector<uint8_t> bytes(n * sizeof(T) * (bits ? 2 : 1));
+      shuffle_encode(data, n, bits, bytes.data(), bytes.data() + n * sizeof(T));
+      auto sz = _save(static_cast<uint8_t>(encoding));
+      _device.write(reinterpret_cast<const char*>(bytes.data()), n * sizeof(T));
+      return sz + n * sizeof(T);
+    }
+    break;
+
+    case Encoding::FP16:
+    case Encoding::BF16:
+    case Encoding::INT8:
+      if constexpr(std::is_floating_point_v<T>) {
+        return _save_quantized(data, n, encoding);
+      }
+    break;
+
+    case Encoding::FOR:
+      if constexpr(is_integer_codable_v<T>) {
+        T base;
+        uint8_t width;
+        std::vector<uint64_t> words;
+        for_encode(data, n, base, width, words);
+        if(sizeof(T) + 1 + words.size() * sizeof(uint64_t) < n * sizeof(T)) {
+          auto sz = _save(static_cast<uint8_t>(Encoding::FOR)) + _save(base) + _save(width);
+          _device.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint64_t));
+          return sz + words.size() * sizeof(uint64_t);
+        }
+      }
+    break;
+
+    default:
+    break;
+  }
+  
+  auto sz = _save(static_cast<uint8_t>(Encoding::RAW));
+  _device.write(reinterpret_cast<const char*>(data), n * sizeof(T));
+  return sz + n * sizeof(T);
+}
+
+// Function: _save_quantized
+// Writes floating-point values as FP16, BF16, or INT8 with one float scale 
+// per block of 256 values ahead of the quantized values.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Serializer<Device, SizeType>::_save_quantized(const T* data, size_t n, Encoding encoding) {
+
+  std::vector<float> narrowed;
+  const float* values = reinterpret_cast<const float*>(data);
+  
+  if constexpr(!std::is_same_v<T, float>) {
+    narrowed.assign(data, data + n);
+    values = narrowed.data();
+  }
+
+  auto sz = _save(static_cast<uint8_t>(encoding));
+
+  if(encoding == Encoding::INT8) {
+    std::vector<float> scales((n + 255) / 256);
+    std::vector<int8_t> bytes(n);
+    int8_encode(values, n, scales.data(), bytes.data());
+    _device.write(reinterpret_cast<const char*>(scales.data()), scales.size() * sizeof(float));
+    _device.write(reinterpret_cast<const char*>(bytes.data()), n);
+    return sz + scales.size() * sizeof(float) + n;
+  }
+  else {
+    std::vector<uint16_t> halves(n);
+    if(encoding == Encoding::FP16) {
+      fp16_encode(values, n, halves.data());
+    }
+    else {
+      bf16_encode(values, n, halves.data());
+    }
+    _device.write(reinterpret_cast<const char*>(halves.data()), n * sizeof(uint16_t));
+    return sz + n * sizeof(uint16_t);
+  }
+}
+
+// Function: _save_columnar
+// Transposes the rows into one column per saved field and writes each column
+// as a length-prefixed contiguous block.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Serializer<Device, SizeType>::_save_columnar(const T& rows) {
+
+  ColumnWriter<SizeType> writer;
+
+  for(auto&& row : rows) {
+    writer.next_row();
+    row.save(writer);
+  }
+  writer.next_row();
+
+  auto& columns = writer.columns();
+
+  auto sz = _save(make_size_tag(rows.size())) + _save(make_size_tag(columns.size()));
+
+  for(auto& column : columns) {
+    sz += _save(make_size_tag(column.size()));
+    _device.write(column.data(), column.size());
+    sz += column.size();
+  }
+
+  return sz;
+}
+
+// ----------------------------------------------------------------------------
+
+// Class: Deserializer
+template <typename Device = std::ostream, typename SizeType = std::streamsize>
+class Deserializer {
+
+  public:
+    
+    Deserializer(Device& device);
+
+#ifdef CIRI_PMR
+    // Loads with the memory resource: temporaries the deserializer creates 
+    // outside any container, such as the values of std::optional and 
+    // std::variant, allocate from it when they are std::pmr types.
+    Deserializer(Device& device, std::pmr::memory_resource* resource);
+#endif
+    
+    template <typename... T>
+    SizeType operator()(T&&... items);
+
+    // Reuse mode recycles the nodes of std::map, std::set, and their 
+    // unordered versions when loading into existing containers, keeping the
+    // capacity of nested strings and vectors. Reloading a structure of 
+    // unchanged shape then performs no heap allocation after warm-up.
+    inline void reuse(bool flag) { _reuse = flag; }
+    inline bool reuse() const { return _reuse; }
+
+    // Parallel mode decodes the chunks of containers written by a parallel 
+    // serializer on the workers of the pool, straight into their final 
+    // slots; a null pool or a pool of one worker turns it off.
+    // Segments of unordered containers are decoded in parallel and then 
+    // inserted, on one thread for a single container or on one thread per 
+    // shard for a sharded one.
+    // It needs a device with view(n), such as InputBuffer over received or 
+    // mapped memory, and otherwise loads sequentially. Containers of 
+    // std::pmr types then allocate from several threads, so their memory 
+    // resource must be thread-safe.
+    inline void parallel(ThreadPool* pool) { _pool = pool; }
+    inline ThreadPool* parallel() const { return _pool; }
+  
+  private:
+
+    Device& _device;
+
+    bool _reuse {false};
+
+    ThreadPool* _pool {nullptr};
+
+#ifdef CIRI_PMR
+    std::pmr::memory_resource* _resource {nullptr};
+#endif
+
+    template <typename T>
+    T _make();
+
+    Deserializer<InputBuffer, SizeType> _nested(InputBuffer&) const;
+
+    uint64_t _bit_word {0};
+    size_t _bit_count {0};
+    size_t _bit_bytes {0};
+    
+    template <typename T>
+    SizeType _load(T&&);
+
+    template <typename T>
+    SizeType _load_item(T&&);
+
+    template <typename T>
+    const T* _view(size_t);
+
+    template <typename T>
+    SizeType _load_contiguous(T&, size_t);
+
+    template <typename T>
+    SizeType _load_nodes(T&, size_t);
+
+    template <typename T>
+    SizeType _load_chunks(T&, size_t);
+
+    template <typename T>
+    SizeType _load_segments(T*, size_t, size_t);
+
+    template <typename T>
+    SizeType _load_routed(T*, size_t, size_t);
+
+    SizeType _load_bits(uint64_t&, size_t);
+    SizeType _flush_bits();
+
+    template <typename T>
+    SizeType _load_columnar(T&);
+
+    template <typename T>
+    SizeType _load_column(size_t, T&);
+
+    template <typename T>
+    SizeType _load_optionals(T*, size_t);
+
+    template <typename T>
+    SizeType _load_encoded(T*, size_t);
+
+    void _skip(size_t);
+    
+    // Function: _variant_helper
+    template <size_t I = 0, typename... ArgsT, std::enable_if_t<I==sizeof...(ArgsT)>* = nullptr>
+    SizeType _variant_helper(size_t, std::variant<ArgsT...>&);
+    
+    // Function: _variant_helper
+    template <size_t I = 0, typename... ArgsT, std::enable_if_t<I<sizeof...(ArgsT)>* = nullptr>
+    SizeType _variant_helper(size_t, std::variant<ArgsT...>&);
+};
+
+// Constructor
+template <typename Device, typename SizeType>
+Deserializer<Device, SizeType>::Deserializer(Device& device) : _device(device) {
+}
+
+#ifdef CIRI_PMR
+// Constructor
+template <typename Device, typename SizeType>
+Deserializer<Device, SizeType>::Deserializer(Device& device, std::pmr::memory_resource* resource) : 
+  _device(device), _resource(resource) {
+}
+#endif
+
+// Function: _make
+// Creates a temporary that has no parent container to take an allocator from.
+template <typename Device, typename SizeType>
+template <typename T>
+T Deserializer<Device, SizeType>::_make() {
+#ifdef CIRI_PMR
+  if(_resource) {
+    return make_using_allocator<T>(std::pmr::polymorphic_allocator<std::byte>(_resource));
+  }
+#endif
+  return T();
+}
+
+// Function: _nested
+// Creates a deserializer over an in-memory part of the input, such as a 
+// parallel chunk, that inherits the memory resource and the reuse mode.
+template <typename Device, typename SizeType>
+Deserializer<InputBuffer, SizeType> Deserializer<Device, SizeType>::_nested(InputBuffer& buffer) const {
+#ifdef CIRI_PMR
+  Deserializer<InputBuffer, SizeType> ar(buffer, _resource);
+#else
+  Deserializer<InputBuffer, SizeType> ar(buffer);
+#endif
+  ar.reuse(_reuse);
+  return ar;
+}
+
+// Operator ()
+template <typename Device, typename SizeType>
+template <typename... T>
+SizeType Deserializer<Device, SizeType>::operator() (T&&... items) {
+  return (_load_item(std::forward<T>(items)) + ... + _flush_bits());
+}
+
+// Function: _load_item
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Deserializer<Device, SizeType>::_load_item(T&& t) {
+  if constexpr(is_bits_v<std::decay_t<T>>) {
+    return _load(std::forward<T>(t));
+  }
+  else {
+    return _flush_bits() + _load(std::forward<T>(t));
+  }
+}
+
+// Function: _load_chunks
+// Loads n elements written in chunks by a parallel serializer, checking 
+// each chunk against its byte count. The container is sized up front so 
+// every chunk decodes into its final slots.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Deserializer<Device, SizeType>::_load_chunks(T& t, size_t n) {
+
+  uint64_t chunk_size;
+  SizeType sz = _load(chunk_size);
+
+  if(chunk_size == 0) {
+    throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted chunk size");
+  }
+
+  t.resize(n);
+
+  const size_t step = std::min<uint64_t>(chunk_size, n);
+
+  // index the chunks by hopping over their byte counts and decode them in 
+  // parallel, each from its own view of the input
+  if constexpr(has_view_v<Device>) {
+    if(_pool && _pool->num_workers() > 1 && n > step) {
+
+      struct Chunk {
+        const char* data;
+        size_t size;
+      };
+
+      std::vector<Chunk> chunks;
+      chunks.reserve((n + step - 1) / step);
+
+      for(size_t first=0; first<n; first+=step) {
+        uint64_t num_bytes;
+        sz += _load(num_bytes);
+        if(num_bytes > static_cast<uint64_t>(std::numeric_limits<std::streamsize>::max())) {
+          throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted chunk");
+        }
+        chunks.push_back({_device.view(num_bytes), static_cast<size_t>(num_bytes)});
+        sz += num_bytes;
+      }
+
+      _pool->parallel_for(chunks.size(), 1, [&] (size_t c, size_t) {
+        InputBuffer buffer(chunks[c].data, chunks[c].size);
+        auto ar = _nested(buffer);
+        const size_t first = c * step;
+        const size_t last = std::min(first + step, n);
+        SizeType chunk_sz {0};
+        for(size_t i=first; i<last; ++i) {
+          chunk_sz += ar(t[i]);
+        }
+        if(static_cast<size_t>(chunk_sz) != chunks[c].size || buffer.remaining() != 0) {
+          throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted chunk");
+        }
+      });
+
+      return sz;
+    }
+  }
+
+  for(size_t first=0; first<n; first+=step) {
+    
+    uint64_t num_bytes;
+    sz += _load(num_bytes);
+
+    const size_t last = std::min(first + step, n);
+    SizeType chunk_sz {0};
+    for(size_t i=first; i<last; ++i) {
+      chunk_sz += _load(t[i]);
+    }
+    
+    if(static_cast<uint64_t>(chunk_sz) != num_bytes) {
+      throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted chunk");
+    }
+    sz += chunk_sz;
+  }
+
+  return sz;
+}
+
+// Function: _load_routed
+// Loads n items of an unordered container and inserts each into its shard.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Deserializer<Device, SizeType>::_load_routed(T* shards, size_t num_shards, size_t n) {
+
+  SizeType sz {0};
+  
+  for(size_t i=0; i<n; ++i) {
+    auto k = make_using_allocator<typename T::key_type>(shards[0].get_allocator());
+    if constexpr(is_std_unordered_map_v<T>) {
+      auto v = make_using_allocator<typename T::mapped_type>(shards[0].get_allocator());
+      sz += _load(make_kv_pair(k, v));
+      auto s = num_shards == 1 ? 0 : shards[0].hash_function()(k) % num_shards;
+      shards[s].emplace(std::move(k), std::move(v));
+    }
+    else {
+      sz += _load(k);
+      auto s = num_shards == 1 ? 0 : shards[0].hash_function()(k) % num_shards;
+      shards[s].emplace(std::move(k));
+    }
+  }
+
+  return sz;
+}
+
+// Function: _load_segments
+// Loads n items written in segments by a parallel serializer into one or 
+// more shards. In parallel mode over a device with view(n), the segments are
+// decoded on separate threads into per-shard buckets, and then every shard 
+// is reserved and filled from its buckets by its own thread. A single 
+// container is therefore filled on one thread, as the standard unordered 
+// containers take no concurrent inserts. Otherwise the segments are loaded 
+// in order.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Deserializer<Device, SizeType>::_load_segments(T* shards, size_t num_shards, size_t n) {
+
+  using Item = SegmentItem_t<T>;
+
+  uint64_t num_segments;
+  SizeType sz = _load(num_segments);
+
+  for(size_t s=0; s<num_shards; ++s) {
+    shards[s].clear();
+  }
+
+  if constexpr(has_view_v<Device>) {
+    if(_pool && _pool->num_workers() > 1 && num_segments > 1) {
+
+      struct Segment {
+        size_t count;
+        const char* data;
+        size_t size;
+      };
+
+      std::vector<Segment> segments;
+      size_t total = 0;
+
+      for(uint64_t i=0; i<num_segments; ++i) {
+        uint64_t count, num_bytes;
+        sz += _load(count);
+        sz += _load(num_bytes);
+        if(count > n - total || num_bytes > static_cast<uint64_t>(std::numeric_limits<std::streamsize>::max())) {
+          throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted segment");
+        }
+        segments.push_back({static_cast<size_t>(count), _device.view(num_bytes), static_cast<size_t>(num_bytes)});
+        sz += num_bytes;
+        total += count;
+      }
+
+      if(total != n) {
+        throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted segment");
+      }
+
+      // items of every segment, bucketed by their shard while decoding so 
+      // that each shard only visits its own
+      std::vector<std::vector<Item>> buckets(segments.size() * num_shards);
+      
+      _pool->parallel_for(segments.size(), 1, [&] (size_t i, size_t) {
+
+        InputBuffer buffer(segments[i].data, segments[i].size);
+        auto ar = _nested(buffer);
+        SizeType segment_sz {0};
+        
+        auto bucket = buckets.data() + i * num_shards;
+        for(size_t s=0; s<num_shards; ++s) {
+          bucket[s].reserve(segments[i].count / num_shards);
+        }
+
+        for(size_t j=0; j<segments[i].count; ++j) {
+          auto k = make_using_allocator<typename T::key_type>(shards[0].get_allocator());
+          if constexpr(is_std_unordered_map_v<T>) {
+            auto v = make_using_allocator<typename T::mapped_type>(shards[0].get_allocator());
+            segment_sz += ar(make_kv_pair(k, v));
+            const size_t s = num_shards == 1 ? 0 : shards[0].hash_function()(k) % num_shards;
+            bucket[s].emplace_back(std::move(k), std::move(v));
+          }
+          else {
+            segment_sz += ar(k);
+            const size_t s = num_shards == 1 ? 0 : shards[0].hash_function()(k) % num_shards;
+            bucket[s].emplace_back(std::move(k));
+          }
+        }
+
+        if(static_cast<size_t>(segment_sz) != segments[i].size || buffer.remaining() != 0) {
+          throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted segment");
+        }
+      });
+
+      _pool->parallel_for(num_shards, 1, [&] (size_t s, size_t) {
+        size_t count = 0;
+        for(size_t i=0; i<segments.size(); ++i) {
+          count += buckets[i * num_shards + s].size();
+        }
+        shards[s].reserve(count);
+        for(size_t i=0; i<segments.size(); ++i) {
+          for(auto& item : buckets[i * num_shards + s]) {
+            shards[s].emplace(std::move(item));
+          }
+        }
+      });
+      
+      return sz;
+    }
+  }
+
+  for(size_t s=0; s<num_shards; ++s) {
+    shards[s].reserve(n / num_shards);
+  }
+
+  size_t total = 0;
+
+  for(uint64_t i=0; i<num_segments; ++i) {
+    uint64_t count, num_bytes;
+    sz += _load(count);
+    sz += _load(num_bytes);
+    if(count > n - total) {
+      throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted segment");
+    }
+    auto segment_sz = _load_routed(shards, num_shards, count);
+    if(static_cast<uint64_t>(segment_sz) != num_bytes) {
+      throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted segment");
+    }
+    sz += segment_sz;
+    total += count;
+  }
+
+  if(total != n) {
+    throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted segment");
+  }
+
+  return sz;
+}
+
+// Function: _load_nodes
+// Loads n items into a node-based associative container in reuse mode. Each
+// key is read into a scratch key and looked up first: a matching element 
+// keeps its node and loads its mapped value in place, so nested strings and
+// vectors keep their capacity. Other keys take the node of a stale element, 
+// and new nodes are only created once those run out. The finished nodes 
+// and the scratch key live in a thread-local pool per container type that 
+// is taken for the duration of the call, so a nested container of the same
+// type starts with an empty pool rather than sharing it. A std::pmr scratch
+// key allocates from the new-delete resource, since the resource of any one
+// container may not outlive the pool.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Deserializer<Device, SizeType>::_load_nodes(T& t, size_t n) {
+
+  constexpr bool is_map = is_std_map_v<T> || is_std_unordered_map_v<T>;
+
+  struct Pool {
+    std::vector<typename T::node_type> nodes;
+    typename T::key_type key {make_scratch<typename T::key_type>()};
+  };
+
+  thread_local Pool pool;
+
+  auto local = std::move(pool);
+  pool.nodes.clear();
+  local.nodes.clear();
+
+  if constexpr(is_std_unordered_map_v<T> || is_std_unordered_set_v<T>) {
+    t.reserve(n);
+  }
+
+  SizeType sz {0};
+  auto& key = local.key;
+
+  for(size_t i=0; i<n; ++i) {
+
+    sz += _load(key);
+
+    if(auto itr = t.find(key); itr != t.end()) {
+      if constexpr(is_map) {
+        sz += _load(itr->second);
+      }
+      local.nodes.push_back(t.extract(itr));
+    }
+    else if(!t.empty()) {
+      auto node = t.extract(t.begin());
+      if constexpr(is_map) {
+        node.key() = key;
+        sz += _load(node.mapped());
+      }
+      else {
+        node.value() = key;
+      }
+      local.nodes.push_back(std::move(node));
+    }
+    else {
+      if constexpr(is_map) {
+        auto v = make_using_allocator<typename T::mapped_type>(t.get_allocator());
+        sz += _load(v);
+        local.nodes.push_back(t.extract(t.emplace(key, std::move(v)).first));
+      }
+      else {
+        local.nodes.push_back(t.extract(t.emplace(key).first));
+      }
+    }
+  }
+
+  // stale elements left over from a larger container are freed here
+  t.clear();
+  for(auto& node : local.nodes) {
+    t.insert(t.end(), std::move(node));
+  }
+
+  local.nodes.clear();
+  pool = std::move(local);
+
+  return sz;
+}
+
+// Function: _load_contiguous
+// Replaces the contents of a std::vector or std::basic_string of arithmetic
+// values with n values read from the device, without first zero-filling 
+// them where possible: strings use resize_and_overwrite when the library 
+// has it, containers with DefaultInitAllocator resize uninitialized, and 
+// other large containers are appended to straight from a memory device or
+// chunk by chunk through a small buffer. A memory device with a thread pool
+// reads sizes of at least PARALLEL_COPY_SIZE into the resized container, 
+// where the copy runs on the pool.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Deserializer<Device, SizeType>::_load_contiguous(T& t, size_t n) {
+
+  using V = typename T::value_type;
+
+  constexpr size_t CHUNK_BYTES = 16384;
+  constexpr size_t CHUNK = CHUNK_BYTES / sizeof(V);
+
+  const size_t num_bytes = n * sizeof(V);
+
+#ifdef __cpp_lib_string_resize_and_overwrite
+  if constexpr(is_std_basic_string_v<T>) {
+    // the operation must not throw, so read errors are rethrown afterwards
+    std::exception_ptr error;
+    t.resize_and_overwrite(n, [&](V* data, size_t) noexcept {
+      try {
+        _device.read(reinterpret_cast<char*>(data), num_bytes);
+        return n;
+      }
+      catch(...) {
+        error = std::current_exception();
+        return size_t{0};
+      }
+    });
+    if(error) {
+      std::rethrow_exception(error);
+    }
+    return num_bytes;
+  }
+  else
+#endif
+  if constexpr(is_default_init_allocator_v<typename T::allocator_type>) {
+    t.resize(n);
+    _device.read(reinterpret_cast<char*>(t.data()), num_bytes);
+    return num_bytes;
+  }
+  else {
+    // small sizes and sizes within the current length overwrite in place
+    if(n <= CHUNK || n <= t.size()) {
+      t.resize(n);
+      _device.read(reinterpret_cast<char*>(t.data()), num_bytes);
+      return num_bytes;
+    }
+    
+    // memory devices with a pool copy large sizes on its workers
+    if constexpr(has_parallel_v<Device>) {
+      if(_device.parallel() && num_bytes >= PARALLEL_COPY_SIZE) {
+        t.resize(n);
+        _device.read(reinterpret_cast<char*>(t.data()), num_bytes);
+        return num_bytes;
+      }
+    }
+    
+    t.clear();
+    t.reserve(n);
+
+    // memory devices hand out the values to copy in one pass when aligned
+    if constexpr(has_view_v<Device>) {
+      const char* ptr = _device.view(num_bytes);
+      if(reinterpret_cast<uintptr_t>(ptr) % alignof(V) == 0) {
+        t.insert(t.end(), reinterpret_cast<const V*>(ptr), reinterpret_cast<const V*>(ptr) + n);
+      }
+      else {
+        t.resize(n);
+        std::memcpy(t.data(), ptr, num_bytes);
+      }
+      return num_bytes;
+    }
+
+    V chunk[CHUNK];
+    for(size_t i=0; i<n; i+=CHUNK) {
+      const size_t k = std::min(CHUNK, n - i);
+      _device.read(reinterpret_cast<char*>(chunk), k * sizeof(V));
+      t.insert(t.end(), chunk, chunk + k);
+    }
+    return num_bytes;
+  }
+}
+
+// Function: _view
+// Consumes n values from a device that exposes its memory and returns a 
+// pointer to them. The pointer stays valid as long as the underlying 
+// buffer does. Values are not copied, so they must be aligned to alignof(T) 
+// in memory; the serializer does not pad, so callers place views at offsets
+// that keep the alignment (e.g., behind 8-byte size tags in an aligned 
+// buffer) and a misaligned view throws.
+template <typename Device, typename SizeType>
+template <typename T>
+const T* Deserializer<Device, SizeType>::_view(size_t n) {
+
+  static_assert(has_view_v<Device>, "Views require a device with view(n), e.g., InputBuffer");
+
+  if(n > std::numeric_limits<std::streamsize>::max() / sizeof(T)) {
+    throw_error(std::errc::result_out_of_range, "ciri: view size out of range");
+  }
+
+  const char* ptr = _device.view(n * sizeof(T));
+
+  if(reinterpret_cast<uintptr_t>(ptr) % alignof(T) != 0) {
+    throw_error(std::errc::invalid_argument, "ciri: misaligned view");
+  }
+
+  return reinterpret_cast<const T*>(ptr);
+}
+
+// Function: _load_bits
+// Mirrors the serializer's word layout and reads only the bytes of the 
+// current word that the requested bits reach into.
+template <typename Device, typename SizeType>
+SizeType Deserializer<Device, SizeType>::_load_bits(uint64_t& value, size_t n) {
+
+  SizeType sz = 0;
+  value = 0;
+
+  for(size_t got = 0; got < n; ) {
+
+    const size_t take = std::min(n - got, 64 - _bit_count);
+    const size_t need = (_bit_count + take + 7) / 8;
+
+    if(need > _bit_bytes) {
+      char bytes[8];
+      _device.read(bytes, need - _bit_bytes);
+      for(size_t i=_bit_bytes; i<need; ++i) {
+        _bit_word |= uint64_t{static_cast<uint8_t>(bytes[i - _bit_bytes])} << (8*i);
+      }
+      sz += need - _bit_bytes;
+      _bit_bytes = need;
+    }
+
+    uint64_t chunk = _bit_word >> _bit_count;
+    if(take < 64) {
+      chunk &= (uint64_t{1} << take) - 1;
+    }
+    value |= chunk << got;
+
+    got += take;
+    _bit_count += take;
+
+    if(_bit_count == 64) {
+      _bit_word = 0;
+      _bit_count = 0;
+      _bit_bytes = 0;
+    }
+  }
+
+  return sz;
+}
+
+// Function: _flush_bits
+// Drops the padding bits left in the current byte.
+template <typename Device, typename SizeType>
+SizeType Deserializer<Device, SizeType>::_flush_bits() {
+  _bit_word = 0;
+  _bit_count = 0;
+  _bit_bytes = 0;
+  return 0;
+}
+
+// Function: _load
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Deserializer<Device, SizeType>::_load(T&& t) {
+
+  using U = std::decay_t<T>;
+  
+  // C array, checked before the decay to a pointer
+  if constexpr(std::is_array_v<std::remove_reference_t<T>>) {
+    
+    using E = std::remove_extent_t<std::remove_reference_t<T>>;
+    constexpr size_t N = std::extent_v<std::remove_reference_t<T>>;
+    
+    size_t num_data;
+    auto sz = _load(make_size_tag(num_data));
+
+    // character arrays also take any shorter string, such as a C string, 
+    // and are padded with terminators
+    if constexpr(is_character_v<E>) {
+      if(num_data > N) {
+        throw_error(std::errc::invalid_argument, "ciri: array size mismatch");
+      }
+      _device.read(reinterpret_cast<char*>(std::data(t)), num_data * sizeof(E));
+      std::fill(std::data(t) + num_data, std::data(t) + N, E());
+      return sz + num_data * sizeof(E);
+    }
+    else if(num_data != N) {
+      throw_error(std::errc::invalid_argument, "ciri: array size mismatch");
+    }
+    
+    if constexpr(std::is_arithmetic_v<E>) {
+      _device.read(reinterpret_cast<char*>(std::data(t)), N * sizeof(E));
+      return sz + N * sizeof(E);
+    }
+    else if constexpr(is_std_optional_v<E>) {
+      return sz + _load_optionals(std::data(t), N);
+    }
+    else {
+      for(auto&& v : t) {
+        sz += _load(v);
+      }
+      return sz;
+    }
+  }
+  // arithmetic data type
+  else if constexpr(std::is_arithmetic_v<U>) {
+    _device.read(reinterpret_cast<char*>(std::addressof(t)), sizeof(t));
+    return sizeof(t);
+  }
+  // std::basic_string
+  else if constexpr(is_std_basic_string_v<U>) {
+    typename U::size_type num_chars;
+    auto sz = _load(make_size_tag(num_chars));
+    return sz + _load_contiguous(t, num_chars);
+  }
+  // std::basic_string_view into the input buffer
+  else if constexpr(is_std_basic_string_view_v<U>) {
+    typename U::size_type num_chars;
+    auto sz = _load(make_size_tag(num_chars));
+    t = U(_view<typename U::value_type>(num_chars), num_chars);
+    return sz + num_chars*sizeof(typename U::value_type);
+  }
+  // span into the input buffer
+  else if constexpr(is_span_v<U>) {
+    using E = typename U::element_type;
+    static_assert(
+      std::is_const_v<E> && std::is_arithmetic_v<std::remove_cv_t<E>>, 
+      "Views load as spans of const arithmetic values"
+    );
+    size_t num_data;
+    auto sz = _load(make_size_tag(num_data));
+    t = U(_view<std::remove_cv_t<E>>(num_data), num_data);
+    return sz + num_data * sizeof(E);
+  }
+  // caller-provided storage; values beyond the capacity are skipped
+  else if constexpr(is_into_v<U>) {
+    using E = std::remove_pointer_t<decltype(t.data())>;
+    size_t num_data;
+    auto sz = _load(make_size_tag(num_data));
+    const size_t num_kept = std::min(num_data, t.capacity());
+    _device.read(reinterpret_cast<char*>(t.data()), num_kept * sizeof(E));
+    for(size_t num_bytes = (num_data - num_kept) * sizeof(E); num_bytes; ) {
+      if constexpr(has_view_v<Device>) {
+        _device.view(num_bytes);
+        num_bytes = 0;
+      }
+      else {
+        char skipped[256];
+        const size_t k = std::min(num_bytes, sizeof(skipped));
+        _device.read(skipped, k);
+        num_bytes -= k;
+      }
+    }
+    t.size() = num_data;
+    return sz + num_data * sizeof(E);
+  }
+  // std::vector
+  else if constexpr(is_std_vector_v<U>) {
+    typename U::size_type num_data;
+    if constexpr(std::is_arithmetic_v<typename U::value_type>) {
+      auto sz = _load(make_size_tag(num_data));
+      return sz + _load_contiguous(t, num_data);
+    } 
+    else if constexpr(is_std_optional_v<typename U::value_type>) {
+      auto sz = _load(make_size_tag(num_data));
+      t.resize(num_data);
+      return sz + _load_optionals(t.data(), num_data);
+    }
+    else {
+      auto sz = _load(make_size_tag(num_data));
+      if(num_data & CHUNKED_SIZE_FLAG) {
+        return sz + _load_chunks(t, num_data & ~CHUNKED_SIZE_FLAG);
+      }
+      t.resize(num_data);
+      for(auto && v : t) {
+        sz += _load(v);
+      }
+      return sz;
+    }
+  }
+  // std::deque, std::list, and std::forward_list
+  else if constexpr(is_std_deque_v<U> || is_std_list_v<U> || is_std_forward_list_v<U>) {
+
+    typename U::size_type num_data;
+    auto sz = _load(make_size_tag(num_data));
+
+    if constexpr(is_std_deque_v<U>) {
+      if(num_data & CHUNKED_SIZE_FLAG) {
+        return sz + _load_chunks(t, num_data & ~CHUNKED_SIZE_FLAG);
+      }
+    }
+
+    t.resize(num_data);
+    for(auto && v : t) {
+      sz += _load(v);
+    }
+    return sz;
+  }
+  // std::map
+  else if constexpr(is_std_map_v<U>) {
+
+    typename U::size_type num_data;
+    auto sz = _load(make_size_tag(num_data));
+
+    if(_reuse) {
+      return sz + _load_nodes(t, num_data);
+    }
+    
+    t.clear();
+    auto hint = t.begin();
+      
+    auto k = make_using_allocator<typename U::key_type>(t.get_allocator());
+    auto v = make_using_allocator<typename U::mapped_type>(t.get_allocator());
+
+    for(size_t i=0; i<num_data; ++i) {
+      sz += _load(make_kv_pair(k, v));
+      hint = t.emplace_hint(hint, std::move(k), std::move(v));
+    }
+    return sz;
+  }
+  // std::unordered_map
+  else if constexpr(is_std_unordered_map_v<U>) {
+
+    typename U::size_type num_data;
+    auto sz = _load(make_size_tag(num_data));
+
+    if(num_data & CHUNKED_SIZE_FLAG) {
+      return sz + _load_segments(std::addressof(t), 1, num_data & ~CHUNKED_SIZE_FLAG);
+    }
+
+    if(_reuse) {
+      return sz + _load_nodes(t, num_data);
+    }
+
+    t.clear();
+    t.reserve(num_data);
+
+    auto k = make_using_allocator<typename U::key_type>(t.get_allocator());
+    auto v = make_using_allocator<typename U::mapped_type>(t.get_allocator());
+
+    for(size_t i=0; i<num_data; ++i) {
+      sz += _load(make_kv_pair(k, v));
+      t.emplace(std::move(k), std::move(v));
+    }
+    
+    return sz;
+  }
+  // std::set
+  else if constexpr(is_std_set_v<U>) {
+
+    typename U::size_type num_data;
+    auto sz = _load(make_size_tag(num_data));
+
+    if(_reuse) {
+      return sz + _load_nodes(t, num_data);
+    }
+
+    t.clear();
+    auto hint = t.begin();
+      
+    auto k = make_using_allocator<typename U::key_type>(t.get_allocator());
+
+    for(size_t i=0; i<num_data; ++i) {   
+      sz += _load(k);
+      hint = t.emplace_hint(hint, std::move(k));
+    }   
+    return sz;
+  }
+  // std::unordered_set
+  else if constexpr(is_std_unordered_set_v<U>) {
+
+    typename U::size_type num_data;
+    auto sz = _load(make_size_tag(num_data));
+
+    if(num_data & CHUNKED_SIZE_FLAG) {
+      return sz + _load_segments(std::addressof(t), 1, num_data & ~CHUNKED_SIZE_FLAG);
+    }
+
+    if(_reuse) {
+      return sz + _load_nodes(t, num_data);
+    }
+
+    t.clear();
+    t.reserve(num_data);
+      
+    auto k = make_using_allocator<typename U::key_type>(t.get_allocator());
+
+    for(size_t i=0; i<num_data; ++i) {   
+      sz += _load(k);
+      t.emplace(std::move(k));
+    }   
+    return sz;
+  }
+  // enum
+  else if constexpr(std::is_enum_v<U>) {
+    std::underlying_type_t<U> k;
+    auto sz = _load(k);
+    t = static_cast<U>(k);
+    return sz;
+  }
+  // std::array
+  else if constexpr(is_std_array_v<U>) {
+    static_assert(std::tuple_size<U>::value > 0, "Array size can't be zero");
+      
+    if constexpr(std::is_arithmetic_v<typename U::value_type>) {
+      _device.read(reinterpret_cast<char*>(t.data()), sizeof(t));
+      return sizeof(t);
+    } 
+    else if constexpr(is_std_optional_v<typename U::value_type>) {
+      return _load_optionals(t.data(), t.size());
+    }
+    else {
+      SizeType sz {0};
+      for(auto && v : t) {
+        sz += _load(v);
+      }
+      return sz;
+    }
+  }
+  // std::variant
+  else if constexpr(is_std_variant_v<U>) {
+    std::decay_t<decltype(t.index())> idx;
+    auto s = _load(idx);
+    return s + _variant_helper(idx, t);
+  }
+  // std::duration
+  else if constexpr(is_std_duration_v<U>) {
+    typename U::rep count;
+    auto s = _load(count);
+    t = U{count};
+    return s;
+  }
+  // std::time_point
+  else if constexpr(is_std_time_point_v<U>) {
+    typename U::duration elapsed;
+    auto s = _load(elapsed);
+    t = U{elapsed};
+    return s;
+  }
+  // std::optional
+  else if constexpr(is_std_optional_v<U>) {
+    bool has_value;
+    auto s = _load(has_value);
+    if(has_value) {
+      if(!t) {
+        t = _make<typename U::value_type>();
+      }
+      s += _load(*t);
+    }
+    else {
+      t.reset(); 
+    }
+    return s;
+  }
+  // std::tuple
+  else if constexpr(is_std_tuple_v<U>) {
+    return std::apply(
+      [this] (auto&&... args) {
+        return (_load(std::forward<decltype(args)>(args)) + ... + 0); 
+      },
+      std::forward<T>(t)
+    );
+  }
+  // columnar std::vector
+  else if constexpr(is_columnar_v<U>) {
+    return _load_columnar(t.get());
+  }
+  // single column of a columnar std::vector
+  else if constexpr(is_column_v<U>) {
+    return _load_column(t.index(), t.get());
+  }
+  // encoded std::vector and std::array
+  else if constexpr(is_encoded_v<U>) {
+    auto& items = t.get();
+    if constexpr(is_std_vector_v<std::decay_t<decltype(items)>>) {
+      typename std::decay_t<decltype(items)>::size_type num_data;
+      auto sz = _load(make_size_tag(num_data));
+      items.resize(num_data);
+      return sz + _load_encoded(items.data(), num_data);
+    }
+    else {
+      return _load_encoded(items.data(), items.size());
+    }
+  }
+  // sharded std::unordered_map and std::unordered_set
+  else if constexpr(is_sharded_v<U>) {
+
+    auto& shards = t.get();
+    if(shards.empty()) {
+      throw_error(std::errc::invalid_argument, "ciri: no shards to load into");
+    }
+
+    size_t num_data;
+    auto sz = _load(make_size_tag(num_data));
+
+    if(num_data & CHUNKED_SIZE_FLAG) {
+      return sz + _load_segments(shards.data(), shards.size(), num_data & ~CHUNKED_SIZE_FLAG);
+    }
+
+    for(auto& shard : shards) {
+      shard.clear();
+      shard.reserve(num_data / shards.size());
+    }
+    return sz + _load_routed(shards.data(), shards.size(), num_data);
+  }
+  // bit field
+  else if constexpr(is_bits_v<U>) {
+    using V = std::decay_t<decltype(t.get())>;
+    using I = std::conditional_t<std::is_enum_v<V>, std::underlying_type<V>, std::common_type<V>>;
+    uint64_t value;
+    auto sz = _load_bits(value, U::width);
+    // sign-extend signed fields from bit N-1
+    if constexpr(std::is_signed_v<typename I::type> && U::width < 64) {
+      const uint64_t sign = uint64_t{1} << (U::width - 1);
+      value = (value ^ sign) - sign;
+    }
+    t.get() = static_cast<V>(static_cast<typename I::type>(value));
+    return sz;
+  }
+  else {
+    return t.load(*this);
+  }
+}
+
+// Function: _load_optionals
+// Reads the validity bitmap and scatters the dense present values back to 
+// their slots; bitmap bytes that are all set or all clear skip the bit tests.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Deserializer<Device, SizeType>::_load_optionals(T* data, size_t n) {
+
+  using V = typename T::value_type;
+
+  std::vector<uint8_t> bitmap((n + 7) / 8);
+  _device.read(reinterpret_cast<char*>(bitmap.data()), bitmap.size());
+  SizeType sz = bitmap.size();
+
+  if constexpr(std::is_arithmetic_v<V>) {
+
+    const size_t num_values = popcount(bitmap.data(), bitmap.size());
+    std::unique_ptr<V[]> values(new V[num_values]);
+    _device.read(reinterpret_cast<char*>(values.get()), num_values * sizeof(V));
+    sz += num_values * sizeof(V);
+
+    const V* value = values.get();
+
+    for(size_t b=0; b<bitmap.size(); ++b) {
+      const size_t beg = b << 3;
+      const size_t end = std::min(beg + 8, n);
+      if(bitmap[b] == 0xFF) {
+        for(size_t i=beg; i<end; ++i) {
+          data[i] = *value++;
+        }
+      }
+      else if(bitmap[b] == 0) {
+        for(size_t i=beg; i<end; ++i) {
+          data[i].reset();
+        }
+      }
+      else {
+        for(size_t i=beg; i<end; ++i) {
+          if(bitmap[b] & (1u << (i & 7))) {
+            data[i] = *value++;
+          }
+          else {
+            data[i].reset();
+          }
+        }
+      }
+    }
+  }
+  else {
+    for(size_t i=0; i<n; ++i) {
+      if(bitmap[i >> 3] & (1u << (i & 7))) {
+        if(!data[i]) {
+          data[i] = _make<V>();
+        }
+        sz += _load(*data[i]);
+      }
+      else {
+        data[i].reset();
+      }
+    }
+  }
+
+  return sz;
+}
+
+// Function: _load_encoded
+// Reads the encoding tag and decodes the payload into n values.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Deserializer<Device, SizeType>::_load_encoded(T* data, size_t n) {
+
+  uint8_t encoding;
+  auto sz = _load(encoding);
+
+  switch(static_cast<Encoding>(encoding)) {
+
+    case Encoding::RAW:
+      _device.read(reinterpret_cast<char*>(data), n * sizeof(T));
+      sz += n * sizeof(T);
+    break;
+
+    case Encoding::RLE: {
+      size_t num_runs;
+      sz += _load(make_size_tag(num_runs));
+      if(num_runs > n) {
+        throw_error(std::errc::invalid_argument, "ciri: corrupted run-length encoding");
+      }
+      std::vector<T> values(num_runs);
+      std::vector<uint32_t> lengths(num_runs);
+      _device.read(reinterpret_cast<char*>(values.data()), num_runs * sizeof(T));
+      _device.read(reinterpret_cast<char*>(lengths.data()), num_runs * sizeof(uint32_t));
+      sz += num_runs * (sizeof(T) + sizeof(uint32_t));
+      size_t i = 0;
+      for(size_t r=0; r<num_runs; ++r) {
+        if(lengths[r] > n - i) {
+          throw_error(std::errc::invalid_argument, "ciri: corrupted run-length encoding");
+        }
+        run_fill(data + i, lengths[r], values[r]);
+        i += lengths[r];
+      }
+      if(i != n) {
+        throw_error(std::errc::invalid_argument, "ciri: corrupted run-length encoding");
+      }
+    }
+    break;
+
+    case Encoding::VARINT:
+    case Encoding::DELTA:
+      if constexpr(is_integer_codable_v<T>) {
+        size_t num_bytes;
+        sz += _load(make_size_tag(num_bytes));
+        if(num_bytes > n * 10) {
+          throw_error(std::errc::invalid_argument, "ciri: corrupted varint encoding");
+        }
+        std::vector<uint8_t> bytes(num_bytes);
+        _device.read(reinterpret_cast<char*>(bytes.data()), num_bytes);
+        sz += num_bytes;
+        if(!varint_decode(bytes.data(), num_bytes, data, n, encoding == static_cast<uint8_t>(Encoding::DELTA))) {
+          throw_error(std::errc::invalid_argument, "ciri: corrupted varint encoding");
+        }
+      }
+      else {
+        throw_error(std::errc::invalid_argument, "ciri: integer encoding of non-integer values");
+      }
+    break;
+
+    case Encoding::FOR:
+      if constexpr(is_integer_codable_v<T>) {
+        T base;
+        uint8_t width;
+        sz += _load(base) + _load(width);
+        if(width > sizeof(T) * 8) {
+          throw_error(std::errc::invalid_argument, "ciri: corrupted frame-of-reference encoding");
+        }
+        std::vector<uint64_t> words((n * width + 63) / 64);
+        _device.read(reinterpret_cast<char*>(words.data()), words.size() * sizeof(uint64_t));
+        sz += words.size() * sizeof(uint64_t);
+        for_decode(words.data(), base, width, data, n);
+      }
+      else {
+        throw_error(std::errc::invalid_argument, "ciri: integer encoding of non-integer values");
+      }
+    break;
+
+    case Encoding::SHUFFLE:
+    case Encoding::BITSHUFFLE: {
+      const bool bits = encoding == static_cast<uint8_t>(Encoding::BITSHUFFLE);
+      std::vector<uint8_t> bytes(n * sizeof(T) * (bits ? 2 : 1));
+      _device.read(reinterpret_cast<char*>(bytes.data()), n * sizeof(T));
+      sz += n * sizeof(T);
+      shuffle_decode(bytes.data(), n, bits, data, bytes.data() + n * sizeof(T));
+    }
+    break;
+
+    case Encoding::FP16:
+    case Encoding::BF16:
+    case Encoding::INT8:
+      if constexpr(std::is_floating_point_v<T>) {
+        
+        std::vector<float> widened;
+        float* values = reinterpret_cast<float*>(data);
+        if constexpr(!std::is_same_v<T, float>) {
+          widened.resize(n);
+          values = widened.data();
+        }
+
+        if(encoding == static_cast<uint8_t>(Encoding::INT8)) {
+          std::vector<float> scales((n + 255) / 256);
+          std::vector<int8_t> bytes(n);
+          _device.read(reinterpret_cast<char*>(scales.data()), scales.size() * sizeof(float));
+          _device.read(reinterpret_cast<char*>(bytes.data()), n);
+          sz += scales.size() * sizeof(float) + n;
+          int8_decode(scales.data(), bytes.data(), n, values);
+        }
+        else {
+          std::vector<uint16_t> halves(n);
+          _device.read(reinterpret_cast<char*>(halves.data()), n * sizeof(uint16_t));
+          sz += n * sizeof(uint16_t);
+          if(encoding == static_cast<uint8_t>(Encoding::FP16)) {
+            fp16_decode(halves.data(), n, values);
+          }
+          else {
+            bf16_decode(halves.data(), n, values);
+          }
+        }
+
+        if constexpr(!std::is_same_v<T, float>) {
+          std::copy(widened.begin(), widened.end(), data);
+        }
+      }
+      else {
+        throw_error(std::errc::invalid_argument, "ciri: quantized encoding of non-floating-point values");
+      }
+    break;
+
+    default:
+      throw_error(std::errc::invalid_argument, "ciri: unknown encoding");
+    break;
+  }
+
+  return sz;
+}
+
+// Function: _load_columnar
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Deserializer<Device, SizeType>::_load_columnar(T& rows) {
+
+  typename T::size_type num_rows;
+  size_t num_cols;
+  auto sz = _load(make_size_tag(num_rows)) + _load(make_size_tag(num_cols));
+
+  std::vector<std::vector<char>> bytes(num_cols);
+  std::vector<InputBuffer> columns;
+  columns.reserve(num_cols);
+
+  for(auto& column : bytes) {
+    size_t num_bytes;
+    sz += _load(make_size_tag(num_bytes));
+    column.resize(num_bytes);
+    _device.read(column.data(), num_bytes);
+    columns.emplace_back(column.data(), num_bytes);
+    sz += num_bytes;
+  }
+
+  rows.resize(num_rows);
+
+  ColumnReader<SizeType> reader(columns);
+
+  for(auto&& row : rows) {
+    reader.next_row();
+    row.load(reader);
+  }
+
+  return sz;
+}
+
+// Function: _load_column
+// Loads the column at the given index and skips over the others.
+template <typename Device, typename SizeType>
+template <typename T>
+SizeType Deserializer<Device, SizeType>::_load_column(size_t index, T& values) {
+  
+  using V = typename T::value_type;
+
+  typename T::size_type num_rows;
+  size_t num_cols;
+  auto sz = _load(make_size_tag(num_rows)) + _load(make_size_tag(num_cols));
+
+  // an empty columnar sequence records no columns, so any column is empty
+  if(num_rows == 0) {
+    values.clear();
+  }
+  else if(index >= num_cols) {
+    throw_error(std::errc::invalid_argument, "ciri: column index out of range");
+  }
+
+  for(size_t c=0; c<num_cols; ++c) {
+
+    size_t num_bytes;
+    sz += _load(make_size_tag(num_bytes));
+
+    if(c != index || num_rows == 0) {
+      _skip(num_bytes);
+    }
+    else if constexpr(std::is_arithmetic_v<V>) {
+      if(num_bytes != num_rows * sizeof(V)) {
+        throw_error(std::errc::invalid_argument, "ciri: column type mismatch");
+      }
+      values.resize(num_rows);
+      _device.read(reinterpret_cast<char*>(values.data()), num_bytes);
+    }
+    else {
+      std::vector<char> column(num_bytes);
+      _device.read(column.data(), num_bytes);
+      InputBuffer buffer(column.data(), num_bytes);
+      auto ar = _nested(buffer);
+      values.resize(num_rows);
+      for(auto&& v : values) {
+        ar(v);
+      }
+    }
+
+    sz += num_bytes;
+  }
+
+  return sz;
+}
+
+// Procedure: _skip
+template <typename Device, typename SizeType>
+void Deserializer<Device, SizeType>::_skip(size_t num_bytes) {
+  if constexpr(has_ignore_v<Device>) {
+    _device.ignore(num_bytes);
+  }
+  else {
+    char buffer[4096];
+    while(num_bytes) {
+      auto n = std::min(num_bytes, sizeof(buffer));
+      _device.read(buffer, n);
+      num_bytes -= n;
+    }
+  }
+}
+  
+// Function: _variant_helper
+template <typename Device, typename SizeType>
+template <size_t I, typename... ArgsT, std::enable_if_t<I==sizeof...(ArgsT)>*>
+SizeType Deserializer<Device, SizeType>::_variant_helper(size_t i, std::variant<ArgsT...>& v) {
+  return 0;
+}
+
+// Function: _variant_helper
+template <typename Device, typename SizeType>
+template <size_t I, typename... ArgsT, std::enable_if_t<I<sizeof...(ArgsT)>*>
+SizeType Deserializer<Device, SizeType>::_variant_helper(size_t i, std::variant<ArgsT...>& v) {
+  if(i == 0) {
+    using type = ExtractType_t<I, std::variant<ArgsT...>>;
+    if(v.index() != I) {
+      static_assert(
+        std::is_default_constructible<type>::value, 
+        "Failed to archive variant (type should be default constructible T())"
+      );
+      v = _make<type>();
+    }
+    return _load(std::get<type>(v));
+  }
+  return _variant_helper<I+1, ArgsT...>(i-1, v);
+}
+
+// ----------------------------------------------------------------------------
+// Columnar Archiver
+// ----------------------------------------------------------------------------
+
+// Class: ColumnWriter
+// Archiver passed to a struct's save method that appends the i-th saved field 
+// of every row to the i-th column.
+template <typename SizeType>
+class ColumnWriter {
+
+  public:
+    
+    template <typename... T>
+    SizeType operator()(T&&... items) {
+      return (_save(std::forward<T>(items)) + ... + 0);
+    }
+
+    // Procedure: next_row
+    // Marks the start of a new row and checks the previous one saved the same 
+    // number of fields as the first row.
+    void next_row() {
+      if(_num_rows++ > 0 && _field != _columns.size()) {
+        throw_error(std::errc::invalid_argument, "ciri: rows save different numbers of fields");
+      }
+      _field = 0;
+    }
+
+    inline std::vector<OutputBuffer>& columns() { return _columns; }
+
+  private:
+
+    std::vector<OutputBuffer> _columns;
+    
+    size_t _num_rows {0};
+    size_t _field {0};
+
+    template <typename T>
+    SizeType _save(T&& item) {
+      if(_field == _columns.size()) {
+        if(_num_rows > 1) {
+          throw_error(std::errc::invalid_argument, "ciri: rows save different numbers of fields");
+        }
+        _columns.emplace_back();
+      }
+      Serializer<OutputBuffer, SizeType> ar(_columns[_field++]);
+      return ar(std::forward<T>(item));
+    }
+};
+
+// Class: ColumnReader
+// Archiver passed to a struct's load method that reads the i-th loaded field 
+// of every row from the i-th column.
+template <typename SizeType>
+class ColumnReader {
+
+  public:
+
+    ColumnReader(std::vector<InputBuffer>& columns) : _columns(columns) {}
+    
+    template <typename... T>
+    SizeType operator()(T&&... items) {
+      return (_load(std::forward<T>(items)) + ... + 0);
+    }
+
+    inline void next_row() { _field = 0; }
+
+  private:
+
+    std::vector<InputBuffer>& _columns;
+
+    size_t _field {0};
+
+    template <typename T>
+    SizeType _load(T&& item) {
+      if(_field == _columns.size()) {
+        throw_error(std::errc::invalid_argument, "ciri: row loads more fields than columns");
+      }
+      Deserializer<InputBuffer, SizeType> ar(_columns[_field++]);
+      return ar(std::forward<T>(item));
+    }
+};
+
+// ----------------------------------------------------------------------------
+// Batch Archiver
+// ----------------------------------------------------------------------------
+
+// Class: BatchSerializer
+// Serializes a batch of independent objects, such as the messages of one 
+// tick, across the workers of a thread pool. Objects are encoded straight 
+// into memory buffers that persist across batches, so no device or stream 
+// is constructed per object and buffer capacity is reused once warm.
+template <typename SizeType = std::streamsize>
+class BatchSerializer {
+
+  public:
+    
+    // Number of consecutive objects a worker encodes before it looks for more 
+    // work. Small messages cost little each, so a grain keeps the pool's 
+    // bookkeeping below the encode cost.
+    static constexpr size_t GRAIN = 16;
+
+    BatchSerializer(ThreadPool& pool) : _pool(pool), _buffers(pool.num_workers()) {}
+    
+    // Serializes objects[i] into outputs[i], replacing its content, and 
+    // returns the total number of bytes. outputs is grown to the batch size.
+    template <typename R>
+    SizeType operator()(const R& objects, std::vector<OutputBuffer>& outputs) {
+
+      const size_t n = std::size(objects);
+      auto first = std::begin(objects);
+
+      if(outputs.size() < n) {
+        outputs.resize(n);
+      }
+
+      _pool.parallel_for(n, GRAIN, [&] (size_t i, size_t) {
+        outputs[i].clear();
+        Serializer<OutputBuffer, SizeType> ar(outputs[i]);
+        ar(first[i]);
+      });
+      
+      SizeType sz = 0;
+      for(size_t i=0; i<n; ++i) {
+        sz += outputs[i].size();
+      }
+      return sz;
+    }
+    
+    // Appends every object to output as a uint64_t byte count followed by its 
+    // encoding, in the order of the range, and returns the number of bytes 
+    // appended. Workers encode into their own buffers, which are then 
+    // gathered in order.
+    template <typename R>
+    SizeType operator()(const R& objects, OutputBuffer& output) {
+
+      const size_t n = std::size(objects);
+      auto first = std::begin(objects);
+
+      for(auto& buffer : _buffers) {
+        buffer.clear();
+      }
+      _frames.resize(n);
+
+      _pool.parallel_for(n, GRAIN, [&] (size_t i, size_t w) {
+        auto& buffer = _buffers[w];
+        size_t offset = buffer.size();
+        Serializer<OutputBuffer, SizeType> ar(buffer);
+        ar(first[i]);
+        _frames[i] = {w, offset, buffer.size() - offset};
+      });
+      
+      size_t total = 0;
+      for(const auto& frame : _frames) {
+        total += sizeof(uint64_t) + frame.size;
+      }
+      output.reserve(output.size() + total);
+
+      for(const auto& frame : _frames) {
+        uint64_t size = frame.size;
+        output.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        output.write(_buffers[frame.worker].data() + frame.offset, frame.size);
+      }
+
+      return total;
+    }
+
+  private:
+
+    struct Frame {
+      size_t worker;
+      size_t offset;
+      size_t size;
+    };
+
+    ThreadPool& _pool;
+
+    std::vector<OutputBuffer> _buffers;
+    std::vector<Frame> _frames;
+};
+
+// ----------------------------------------------------------------------------
+// Append Log
+// ----------------------------------------------------------------------------
+
+// Class: AppendLog
+// Shared log that many threads append serialized records to without locks. 
+// A producer reserves a slot in a ring buffer with one atomic fetch-add, 
+// encodes its items in place, and publishes the slot by setting the commit 
+// flag in its header. A background thread writes the committed slots to the 
+// device in reservation order, so the device receives the records back to 
+// back as if one Serializer had saved them in turn.
+//
+// A slot is a 16-byte header, holding the slot length with the commit flag 
+// and the record size, followed by the record padded to 8 bytes; the record
+// may wrap around the end of the ring. Producers wait for the flusher only 
+// when the ring is full. The flusher sleeps while the slot at the tail is 
+// uncommitted, and a producer takes the lock to wake it only if it sleeps.
+// The device is used by the flusher thread alone until the log is closed.
+template <typename Device, typename SizeType = std::streamsize>
+class AppendLog {
+
+  public:
+
+    AppendLog(Device& device, size_t capacity = size_t{1} << 22);
+
+    ~AppendLog();
+
+    AppendLog(const AppendLog&) = delete;
+    AppendLog& operator = (const AppendLog&) = delete;
+    
+    // Appends one record holding the items, sized by a first pass through a 
+    // ByteCounter, and returns its size.
+    template <typename... T>
+    SizeType operator()(T&&... items);
+    
+    // Appends one record holding the items in a slot of max_size bytes, which
+    // saves the sizing pass; throws when the record does not fit.
+    template <typename... T>
+    SizeType bounded(size_t max_size, T&&... items);
+    
+    // Blocks until every record appended before the call is written to the 
+    // device, and rethrows the first error the flusher ran into.
+    void flush();
+    
+    // Writes the remaining records, stops the flusher, and rethrows the 
+    // first error it ran into; later appends throw. The destructor closes 
+    // the log as well but drops the error.
+    void close();
+
+    inline size_t capacity() const { return _mask + 1; }
+
+  private:
+
+    static constexpr uint64_t COMMITTED = uint64_t{1} << 63;
+    
+    // Output device over a reserved slot of the ring
+    struct Slot {
+
+      char* ring;
+      uint64_t mask;
+      uint64_t cursor;
+      uint64_t end;
+
+      inline void write(const char* data, std::streamsize n) {
+        if(static_cast<uint64_t>(n) > end - cursor) {
+          throw_error(std::errc::no_buffer_space, "ciri: record exceeds its slot in append log");
+        }
+        auto beg = cursor & mask;
+        auto first = std::min<uint64_t>(n, mask + 1 - beg);
+        std::memcpy(ring + beg, data, first);
+        std::memcpy(ring, data + first, n - first);
+        cursor += n;
+      }
+    };
+
+    Device& _device;
+
+    uint64_t _mask;
+    std::unique_ptr<std::atomic<uint64_t>[]> _words;
+
+    alignas(64) std::atomic<uint64_t> _head {0};
+    alignas(64) std::atomic<uint64_t> _tail {0};
+    std::atomic<bool> _stop {false};
+    
+    // the flusher sleeps on _flush_cv, producers that wait for space and 
+    // callers of flush on _tail_cv
+    std::atomic<bool> _idle {false};
+    std::atomic<size_t> _waiters {0};
+
+    std::mutex _mutex;
+    std::condition_variable _flush_cv;
+    std::condition_variable _tail_cv;
+    std::exception_ptr _error;
+    std::thread _flusher;
+
+    inline char* _ring() { return reinterpret_cast<char*>(_words.get()); }
+    inline std::atomic<uint64_t>& _header(uint64_t pos) { return _words[(pos & _mask) / 8]; }
+
+    template <typename... T>
+    SizeType _append(size_t, T&&...);
+
+    void _flush_loop();
+    bool _drain();
+    bool _ready();
+    void _publish(uint64_t, uint64_t);
+    void _wait_tail(uint64_t);
+};
+
+// Constructor
+template <typename Device, typename SizeType>
+AppendLog<Device, SizeType>::AppendLog(Device& device, size_t capacity) : _device(device) {
+  size_t size = 64;
+  while(size < capacity) {
+    size <<= 1;
+  }
+  _mask = size - 1;
+  _words = std::make_unique<std::atomic<uint64_t>[]>(size / 8);
+  for(size_t i=0; i<size/8; ++i) {
+    _words[i].store(0, std::memory_order_relaxed);
+  }
+  _flusher = std::thread([this] () { _flush_loop(); });
+}
+
+// Destructor
+template <typename Device, typename SizeType>
+AppendLog<Device, SizeType>::~AppendLog() {
+  try {
+    close();
+  }
+  catch(...) {
+  }
+}
+
+// Function: operator()
+template <typename Device, typename SizeType>
+template <typename... T>
+SizeType AppendLog<Device, SizeType>::operator()(T&&... items) {
+  ByteCounter counter;
+  Serializer<ByteCounter, SizeType> ar(counter);
+  ar(items...);
+  return _append(counter.size(), std::forward<T>(items)...);
+}
+
+// Function: bounded
+template <typename Device, typename SizeType>
+template <typename... T>
+SizeType AppendLog<Device, SizeType>::bounded(size_t max_size, T&&... items) {
+  return _append(max_size, std::forward<T>(items)...);
+}
+
+// Function: _append
+template <typename Device, typename SizeType>
+template <typename... T>
+SizeType AppendLog<Device, SizeType>::_append(size_t max_size, T&&... items) {
+
+  const uint64_t length = 16 + ((max_size + 7) & ~uint64_t{7});
+
+  if(max_size > capacity() || length > capacity()) {
+    throw_error(std::errc::no_buffer_space, "ciri: record exceeds append log capacity");
+  }
+
+  if(_stop.load(std::memory_order_relaxed)) {
+    throw_error(std::errc::broken_pipe, "ciri: append to closed log");
+  }
+
+  const auto pos = _head.fetch_add(length, std::memory_order_relaxed);
+
+  // the slot is free once the flusher has passed it on the previous lap
+  _wait_tail(pos + length - capacity());
+
+  Slot slot {_ring(), _mask, pos + 16, pos + 16 + max_size};
+  Serializer<Slot, SizeType> ar(slot);
+
+  // a failed record is published empty so that it does not stall the log
+  try {
+    ar(std::forward<T>(items)...);
+  }
+  catch(...) {
+    _publish(pos, length);
+    throw;
+  }
+
+  const auto size = slot.cursor - pos - 16;
+  _header(pos + 8).store(size, std::memory_order_relaxed);
+  _publish(pos, length);
+  
+  return static_cast<SizeType>(size);
+}
+
+// Procedure: _publish
+// Sets the commit flag of the slot and wakes the flusher if it sleeps. The 
+// fences pair with those of _flush_loop, so either the producer sees the 
+// flusher idle or the flusher sees the commit.
+template <typename Device, typename SizeType>
+void AppendLog<Device, SizeType>::_publish(uint64_t pos, uint64_t length) {
+  _header(pos).store(COMMITTED | length, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(_idle.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _flush_cv.notify_one();
+  }
+}
+
+// Procedure: _wait_tail
+// Blocks until the flusher has moved the tail to pos or beyond.
+template <typename Device, typename SizeType>
+void AppendLog<Device, SizeType>::_wait_tail(uint64_t pos) {
+  
+  if(static_cast<int64_t>(pos - _tail.load(std::memory_order_acquire)) <= 0) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _waiters.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  _tail_cv.wait(lock, [&] () { 
+    return static_cast<int64_t>(pos - _tail.load(std::memory_order_acquire)) <= 0; 
+  });
+  _waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// Procedure: flush
+template <typename Device, typename SizeType>
+void AppendLog<Device, SizeType>::flush() {
+  _wait_tail(_head.load(std::memory_order_relaxed));
+  std::lock_guard<std::mutex> lock(_mutex);
+  if(_error) {
+    std::rethrow_exception(std::exchange(_error, nullptr));
+  }
+}
+
+// Procedure: close
+template <typename Device, typename SizeType>
+void AppendLog<Device, SizeType>::close() {
+
+  if(!_flusher.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop.store(true, std::memory_order_relaxed);
+  }
+  _flush_cv.notify_one();
+  _flusher.join();
+  
+  if(_error) {
+    std::rethrow_exception(std::exchange(_error, nullptr));
+  }
+}
+
+// Procedure: _flush_loop
+// Drains the ring until the log is closed and every reserved slot is 
+// written, sleeping while the slot at the tail is uncommitted.
+template <typename Device, typename SizeType>
+void AppendLog<Device, SizeType>::_flush_loop() {
+  while(true) {
+
+    if(_drain()) {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    
+    if(_stop.load(std::memory_order_relaxed) && 
+       _tail.load(std::memory_order_relaxed) == _head.load(std::memory_order_acquire)) {
+      return;
+    }
+    
+    _idle.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    _flush_cv.wait(lock, [this] () { 
+      return _ready() || (
+        _stop.load(std::memory_order_relaxed) && 
+        _tail.load(std::memory_order_relaxed) == _head.load(std::memory_order_acquire)
+      );
+    });
+    _idle.store(false, std::memory_order_relaxed);
+  }
+}
+
+// Function: _ready
+// Returns whether the slot at the tail is committed.
+template <typename Device, typename SizeType>
+bool AppendLog<Device, SizeType>::_ready() {
+  const auto tail = _tail.load(std::memory_order_relaxed);
+  return tail < _head.load(std::memory_order_acquire) && 
+         (_header(tail).load(std::memory_order_acquire) & COMMITTED);
+}
+
+// Function: _drain
+// Writes the committed slots at the tail to the device, zeroes them for the 
+// next lap, and returns whether there were any.
+template <typename Device, typename SizeType>
+bool AppendLog<Device, SizeType>::_drain() {
+
+  const auto beg = _tail.load(std::memory_order_relaxed);
+  const auto head = _head.load(std::memory_order_acquire);
+  
+  auto end = beg;
+
+  // headers a lap ahead share words with the slots being drained, which are 
+  // only zeroed at the end
+  while(end < head && end < beg + capacity()) {
+
+    const auto header = _header(end).load(std::memory_order_acquire);
+    
+    if(!(header & COMMITTED)) {
+      break;
+    }
+
+    const auto size = _header(end + 8).load(std::memory_order_relaxed);
+    const auto from = (end + 16) & _mask;
+    const auto first = std::min<uint64_t>(size, _mask + 1 - from);
+    
+    try {
+      _device.write(_ring() + from, first);
+      if(size > first) {
+        _device.write(_ring(), size - first);
+      }
+    }
+    catch(...) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if(!_error) {
+        _error = std::current_exception();
+      }
+    }
+
+    end += header & ~COMMITTED;
+  }
+
+  if(end == beg) {
+    return false;
+  }
+
+  for(auto pos = beg; pos < end; pos += 8) {
+    _header(pos).store(0, std::memory_order_relaxed);
+  }
+  _tail.store(end, std::memory_order_release);
+  
+  // pairs with the fence of _wait_tail
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(_waiters.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tail_cv.notify_all();
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Incremental Archiver
+// ----------------------------------------------------------------------------
+
+// Class: IncrementalSerializer
+// Serializer that encodes in bounded steps, so that a thread with latency 
+// limits can save a large structure a slice at a time. The position is kept 
+// on an explicit stack of frames, one per container or struct being walked:
+// sequences, sets, maps, std::array, and std::tuple are descended into, 
+// contiguous arithmetic data is cut into slices, and every other item is 
+// encoded whole by a Serializer. Elements encoded whole are taken in a run 
+// without a frame of their own. A user-defined struct is descended into 
+// only if every item its save passes is a member of the struct and one of 
+// them is walked; a struct that also passes locals, temporaries, or bit 
+// fields is encoded whole. The output is the same as that of Serializer. 
+// The items must neither be destroyed nor modified until the serialization 
+// is done.
+template <typename Device, typename SizeType = std::streamsize>
+class IncrementalSerializer {
+
+  public:
+
+    IncrementalSerializer(Device& device) : _device(device), _serializer(device) {}
+    
+    // Queues the items for the following steps; throws while a previous 
+    // serialization is still in progress.
+    template <typename... T>
+    void start(T&&... items);
+    
+    // Encodes until max_bytes are written or max_time has passed, checked 
+    // between elements and slices of contiguous data, and returns whether 
+    // the serialization is done. An item encoded whole may take a step past
+    // its budgets.
+    bool step(size_t max_bytes, std::chrono::nanoseconds max_time = std::chrono::nanoseconds::max());
+
+    // Drops the unfinished serialization, e.g., after a device error.
+    inline void reset() { _stack.clear(); }
+
+    inline bool done() const { return _stack.empty(); }
+    
+    // Number of bytes written since the last start
+    inline SizeType size() const { return _size; }
+
+  private:
+
+    using Self = IncrementalSerializer;
+
+    struct Frame {
+      virtual ~Frame() = default;
+      // advances by elements while the budget lasts and returns true once 
+      // there are none left
+      virtual bool step(Self&) = 0;
+    };
+    
+    // Item of a tuple or a struct, pushed through a function pointer
+    struct Item {
+      const void* ptr;
+      bool (*push)(Self&, const void*);
+    };
+
+    struct ItemsFrame : Frame {
+      std::vector<Item> items;
+      size_t next {0};
+      bool step(Self& s) override {
+        while(next < items.size() && s._budget) {
+          const auto& item = items[next++];
+          if(item.push(s, item.ptr)) {
+            return false;
+          }
+          s._tick();
+        }
+        return next == items.size();
+      }
+    };
+
+    template <typename It>
+    struct SequenceFrame : Frame {
+      It it, end;
+      SequenceFrame(It b, It e) : it(b), end(e) {}
+      bool step(Self& s) override {
+        while(it != end && s._budget) {
+          const auto& item = *it;
+          ++it;
+          if(s._push(item)) {
+            return false;
+          }
+          s._tick();
+        }
+        return it == end;
+      }
+    };
+
+    template <typename It>
+    struct MapFrame : Frame {
+      It it, end;
+      MapFrame(It b, It e) : it(b), end(e) {}
+      bool step(Self& s) override {
+        while(it != end && s._budget) {
+          const auto& [k, v] = *it;
+          ++it;
+          s._leaf(k);
+          if(s._push(v)) {
+            return false;
+          }
+          s._tick();
+        }
+        return it == end;
+      }
+    };
+
+    struct ContiguousFrame : Frame {
+      const char* data;
+      size_t size;
+      size_t offset {0};
+      ContiguousFrame(const char* d, size_t n) : data(d), size(n) {}
+      bool step(Self& s) override {
+        while(offset < size && s._budget) {
+          const size_t k = std::min({size - offset, s._budget, _slice});
+          s._write(data + offset, k);
+          offset += k;
+          s._tick();
+        }
+        return offset == size;
+      }
+    };
+    
+    // Archiver passed to the save method of a user-defined struct to check 
+    // its items and, given a list, to collect them in order. Items outside 
+    // the struct may be locals of save that are gone by the time a frame 
+    // would reach them, and bit fields are packed across the items of a 
+    // call, so either keeps the struct whole.
+    class Collector {
+
+      public:
+
+        Collector(const void* t, size_t n, std::vector<Item>* items) : 
+          _beg(static_cast<const char*>(t)), _end(_beg + n), _items(items) {
+        }
+
+        bool whole {false};
+        bool walked {false};
+
+        template <typename... T>
+        SizeType operator()(T&&... items) {
+          (_add(std::forward<T>(items)), ...);
+          return 0;
+        }
+
+      private:
+
+        const char* _beg;
+        const char* _end;
+
+        std::vector<Item>* _items;
+
+        template <typename T>
+        void _add(T&& item) {
+          using U = std::decay_t<T>;
+          if constexpr(is_bits_v<U> || !std::is_lvalue_reference_v<T>) {
+            whole = true;
+          }
+          else {
+            const auto ptr = reinterpret_cast<const char*>(std::addressof(item));
+            if(std::less<const char*>{}(ptr, _beg) || !std::less<const char*>{}(ptr, _end)) {
+              whole = true;
+            }
+            else {
+              walked = walked || _layout<U>() != WHOLE;
+              if(_items) {
+                _items->push_back(_item(item));
+              }
+            }
+          }
+        }
+    };
+
+    // has_save: a user-defined struct the serializer can descend into
+    template <typename T, typename = void>
+    struct has_save : std::false_type {};
+    
+    template <typename T>
+    struct has_save <T, std::void_t<decltype(std::declval<const T&>().save(std::declval<Collector&>()))>> : 
+      std::true_type {};
+
+    enum Layout { WHOLE, CONTIGUOUS, SEQUENCE, MAP, TUPLE, STRUCT };
+    
+    // How _push walks an item, matching the layout Serializer gives it
+    template <typename U>
+    static constexpr Layout _layout() {
+      if constexpr(is_std_vector_v<U> || is_std_basic_string_v<U> || is_std_array_v<U>) {
+        using V = typename U::value_type;
+        if constexpr(std::is_arithmetic_v<V>) {
+          return std::is_same_v<V, bool> ? WHOLE : CONTIGUOUS;
+        }
+        else if constexpr(!is_std_basic_string_v<U> && !is_std_optional_v<V>) {
+          return SEQUENCE;
+        }
+        else {
+          return WHOLE;
+        }
+      }
+      else if constexpr(
+        is_std_deque_v<U> || is_std_list_v<U> || is_std_forward_list_v<U> || 
+        is_std_set_v<U> || is_std_unordered_set_v<U>
+      ) {
+        return SEQUENCE;
+      }
+      else if constexpr(is_std_map_v<U> || is_std_unordered_map_v<U>) {
+        return MAP;
+      }
+      else if constexpr(is_std_tuple_v<U>) {
+        return _walks_tuple<U>(std::make_index_sequence<std::tuple_size_v<U>>{}) ? TUPLE : WHOLE;
+      }
+      else if constexpr(std::is_class_v<U> && has_save<U>::value) {
+        return STRUCT;
+      }
+      else {
+        return WHOLE;
+      }
+    }
+    
+    // A tuple is walked if any of its elements is
+    template <typename U, size_t... I>
+    static constexpr bool _walks_tuple(std::index_sequence<I...>) {
+      return ((_layout<std::decay_t<std::tuple_element_t<I, U>>>() != WHOLE) || ...);
+    }
+
+    template <typename T>
+    static Item _item(const T& t) {
+      return {std::addressof(t), [] (Self& s, const void* ptr) { 
+        return s._push(*static_cast<const T*>(ptr)); 
+      }};
+    }
+
+    Device& _device;
+
+    Serializer<Device, SizeType> _serializer;
+
+    std::vector<std::unique_ptr<Frame>> _stack;
+
+    // largest piece of contiguous data written between two clock reads
+    static constexpr size_t _slice = 1 << 16;
+
+    SizeType _size {0};
+    size_t _budget {0};
+    
+    std::chrono::steady_clock::time_point _beg;
+    std::chrono::nanoseconds _max_time;
+    size_t _ticks {0};
+    SizeType _mark {0};
+
+    inline void _count(size_t n) {
+      _size += n;
+      _budget -= std::min(_budget, n);
+    }
+    
+    // Ends the step once max_time has passed; the clock is read every few 
+    // elements to keep its cost off small ones, or as soon as a slice worth 
+    // of bytes has been written since the last read.
+    inline void _tick() {
+      if(++_ticks % 64 == 0 || static_cast<size_t>(_size - _mark) >= _slice) {
+        _mark = _size;
+        if(std::chrono::steady_clock::now() - _beg >= _max_time) {
+          _budget = 0;
+        }
+      }
+    }
+
+    inline void _write(const char* data, size_t n) {
+      _device.write(data, n);
+      _count(n);
+    }
+
+    template <typename T>
+    void _leaf(const T& t) {
+      _count(_serializer(t));
+    }
+
+    template <typename T>
+    bool _push(const T&);
+};
+
+// Procedure: start
+template <typename Device, typename SizeType>
+template <typename... T>
+void IncrementalSerializer<Device, SizeType>::start(T&&... items) {
+
+  static_assert(
+    (std::is_lvalue_reference_v<T> && ...), 
+    "Incremental serialization requires items that outlive it"
+  );
+
+  if(!done()) {
+    throw_error(std::errc::operation_in_progress, "ciri: incremental serialization in progress");
+  }
+
+  auto frame = std::make_unique<ItemsFrame>();
+  frame->items = {_item(items)...};
+
+  _size = 0;
+  _stack.push_back(std::move(frame));
+}
+
+// Function: step
+template <typename Device, typename SizeType>
+bool IncrementalSerializer<Device, SizeType>::step(size_t max_bytes, std::chrono::nanoseconds max_time) {
+
+  _beg = std::chrono::steady_clock::now();
+  _max_time = max_time;
+  _ticks = 0;
+  _mark = _size;
+
+  _budget = std::max(max_bytes, size_t{1});
+  
+  while(!_stack.empty() && _budget) {
+    if(_stack.back()->step(*this)) {
+      _stack.pop_back();
+    }
+    _tick();
+  }
+
+  return done();
+}
+
+// Function: _push
+// Encodes a whole item, or pushes the frame that walks it after writing 
+// the size tag and returns true.
+template <typename Device, typename SizeType>
+template <typename T>
+bool IncrementalSerializer<Device, SizeType>::_push(const T& t) {
+
+  using U = std::decay_t<T>;
+
+  if constexpr(_layout<U>() == CONTIGUOUS) {
+    if constexpr(!is_std_array_v<U>) {
+      _leaf(make_size_tag(t.size()));
+    }
+    _stack.push_back(std::make_unique<ContiguousFrame>(
+      reinterpret_cast<const char*>(t.data()), t.size() * sizeof(typename U::value_type)
+    ));
+    return true;
+  }
+  else if constexpr(_layout<U>() == SEQUENCE) {
+    if constexpr(is_std_forward_list_v<U>) {
+      _leaf(make_size_tag(std::distance(t.begin(), t.end())));
+    }
+    else if constexpr(!is_std_array_v<U>) {
+      _leaf(make_size_tag(t.size()));
+    }
+    _stack.push_back(std::make_unique<SequenceFrame<typename U::const_iterator>>(t.begin(), t.end()));
+    return true;
+  }
+  else if constexpr(_layout<U>() == MAP) {
+    _leaf(make_size_tag(t.size()));
+    _stack.push_back(std::make_unique<MapFrame<typename U::const_iterator>>(t.begin(), t.end()));
+    return true;
+  }
+  else if constexpr(_layout<U>() == TUPLE) {
+    auto frame = std::make_unique<ItemsFrame>();
+    std::apply([&] (const auto&... items) { frame->items = {_item(items)...}; }, t);
+    _stack.push_back(std::move(frame));
+    return true;
+  }
+  else if constexpr(_layout<U>() == STRUCT) {
+    // a first pass checks the items without collecting them, so structs 
+    // encoded whole, such as small ones in a long sequence, allocate nothing
+    Collector check(std::addressof(t), sizeof(t), nullptr);
+    t.save(check);
+    if(check.whole || !check.walked) {
+      _leaf(t);
+      return false;
+    }
+    auto frame = std::make_unique<ItemsFrame>();
+    Collector collector(std::addressof(t), sizeof(t), &frame->items);
+    t.save(collector);
+    _stack.push_back(std::move(frame));
+    return true;
+  }
+  else {
+    _leaf(t);
+    return false;
+  }
+}
+
+#ifdef CIRI_COROUTINE
+
+// ----------------------------------------------------------------------------
+// Async Archiver
+// ----------------------------------------------------------------------------
+
+// The async archivers run as C++20 coroutines over non-blocking byte streams,
+// so an event loop can interleave many of them on one thread. A sink has
+//
+//   std::streamsize write_some(const char* data, std::streamsize n);
+//   awaitable writable();
+//
+// where write_some accepts up to n bytes, zero when its buffer is full, and 
+// writable suspends until the loop sees the stream writable again. A source
+// has read_some(char*, n), which returns zero when no bytes are ready and a
+// negative value at the end of the stream, and readable(). Every call of an 
+// async serializer writes one frame holding the items as Serializer encodes
+// them, split into chunks of a uint32_t byte count followed by the bytes and
+// ended by an empty chunk, so no pass is needed to size the frame first.
+//
+// Both sides walk std::vector, std::deque, std::list, std::map, 
+// std::unordered_map, std::set, and std::unordered_set element by element 
+// at any depth, and move contiguous arithmetic data in place, suspending 
+// whenever the stream is not ready. Any other item, such as a struct with 
+// save, a tuple, or an element of another container, is encoded and decoded
+// in one step, bounded by max_size. The serializer cuts chunks only between
+// such items, so the deserializer decodes each one from the chunk that holds
+// it as soon as that chunk has arrived.
+
+// TaskPromise: stores the result of a Task
+template <typename T>
+struct TaskPromise {
+
+  std::optional<T> value;
+
+  void return_value(T v) { value.emplace(std::move(v)); }
+  T take() { return std::move(*value); }
+};
+
+template <>
+struct TaskPromise <void> {
+  void return_void() {}
+  void take() {}
+};
+
+// Class: Task
+// Lazily started coroutine that resumes its awaiter when it finishes. A task
+// that is not awaited, such as the root task of a connection, is started 
+// with start and polled with done.
+template <typename T = void>
+class Task {
+
+  public:
+
+    struct promise_type : TaskPromise<T> {
+
+      std::exception_ptr error;
+      std::coroutine_handle<> continuation {std::noop_coroutine()};
+
+      Task get_return_object() { 
+        return Task(std::coroutine_handle<promise_type>::from_promise(*this)); 
+      }
+
+      std::suspend_always initial_suspend() noexcept { return {}; }
+
+      auto final_suspend() noexcept {
+        struct Awaiter {
+          bool await_ready() noexcept { return false; }
+          std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+            return h.promise().continuation;
+          }
+          void await_resume() noexcept {}
+        };
+        return Awaiter{};
+      }
+
+      void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    Task(Task&& rhs) : _handle(std::exchange(rhs._handle, nullptr)) {}
+
+    Task& operator = (Task&& rhs) {
+      if(this != &rhs) {
+        if(_handle) {
+          _handle.destroy();
+        }
+        _handle = std::exchange(rhs._handle, nullptr);
+      }
+      return *this;
+    }
+
+    ~Task() {
+      if(_handle) {
+        _handle.destroy();
+      }
+    }
+
+    inline void start() { _handle.resume(); }
+    inline bool done() const { return _handle.done(); }
+
+    // Returns the result of a finished task, or rethrows its exception.
+    T get() {
+      if(_handle.promise().error) {
+        std::rethrow_exception(_handle.promise().error);
+      }
+      return _handle.promise().take();
+    }
+
+    auto operator co_await() && noexcept {
+      struct Awaiter {
+        std::coroutine_handle<promise_type> handle;
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+          handle.promise().continuation = awaiter;
+          return handle;
+        }
+        T await_resume() {
+          if(handle.promise().error) {
+            std::rethrow_exception(handle.promise().error);
+          }
+          return handle.promise().take();
+        }
+      };
+      return Awaiter{_handle};
+    }
+
+  private:
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+    std::coroutine_handle<promise_type> _handle;
+};
+
+// Layouts the async archivers walk, matching those Serializer gives them
+enum class AsyncLayout { WHOLE, CONTIGUOUS, SEQUENCE, MAP, SET };
+
+// Function: async_layout
+template <typename U>
+constexpr AsyncLayout async_layout() {
+  if constexpr(is_std_vector_v<U> || is_std_basic_string_v<U> || is_std_deque_v<U> || is_std_list_v<U>) {
+    using V = typename U::value_type;
+    if constexpr((is_std_vector_v<U> || is_std_basic_string_v<U>) && std::is_arithmetic_v<V> && !std::is_same_v<V, bool>) {
+      return AsyncLayout::CONTIGUOUS;
+    }
+    else if constexpr(!is_std_basic_string_v<U> && !std::is_arithmetic_v<V> && !is_std_optional_v<V>) {
+      return AsyncLayout::SEQUENCE;
+    }
+    else {
+      return AsyncLayout::WHOLE;
+    }
+  }
+  else if constexpr(is_std_map_v<U> || is_std_unordered_map_v<U>) {
+    return AsyncLayout::MAP;
+  }
+  else if constexpr(is_std_set_v<U> || is_std_unordered_set_v<U>) {
+    return AsyncLayout::SET;
+  }
+  else {
+    return AsyncLayout::WHOLE;
+  }
+}
+
+// Class: AsyncSerializer
+// Serializer that writes to a non-blocking sink and suspends while the sink 
+// is full. Items are encoded into a small buffer that is sent as a chunk 
+// whenever it passes the high-water mark, so a large container is sent 
+// element by element and contiguous arithmetic data is sent from the 
+// container itself. Elements encoded whole, and contiguous ones below the 
+// high-water mark, are encoded in the loop over their container without a 
+// coroutine frame each.
+template <typename Sink, typename SizeType = std::streamsize>
+class AsyncSerializer {
+
+  public:
+
+    // max_size bounds the chunks and the items encoded whole, and matches 
+    // the default of AsyncDeserializer.
+    AsyncSerializer(Sink& sink, size_t high_water = 1 << 16, size_t max_size = 1 << 26) : 
+      _sink(sink), _high_water(high_water), _max_size(std::max(max_size, size_t{1})) {
+    }
+    
+    // Writes the items as one frame; they must outlive the returned task.
+    template <typename... T>
+    Task<SizeType> operator()(const T&... items);
+
+  private:
+
+    Sink& _sink;
+
+    size_t _high_water;
+    size_t _max_size;
+
+    OutputBuffer _buffer;
+
+    uint64_t _size {0};
+    
+    template <typename T>
+    void _encode(const T&);
+
+    template <typename T>
+    bool _put(const T&);
+    
+    template <typename T>
+    Task<> _save(const T&);
+
+    Task<> _write(const char*, size_t);
+    Task<> _write_chunk(const char*, size_t);
+    Task<> _drain();
+};
+
+// Function: operator()
+template <typename Sink, typename SizeType>
+template <typename... T>
+Task<SizeType> AsyncSerializer<Sink, SizeType>::operator()(const T&... items) {
+
+  _buffer.clear();
+  _size = 0;
+
+  (co_await _save(items), ...);
+  co_await _drain();
+
+  // the empty chunk that ends the frame
+  uint32_t end = 0;
+  co_await _write(reinterpret_cast<const char*>(&end), sizeof(end));
+
+  co_return static_cast<SizeType>(_size);
+}
+
+// Function: _encode
+// Encodes an item whole into the buffer.
+template <typename Sink, typename SizeType>
+template <typename T>
+void AsyncSerializer<Sink, SizeType>::_encode(const T& t) {
+
+  const size_t before = _buffer.size();
+  Serializer<OutputBuffer, SizeType> ar(_buffer);
+  ar(t);
+
+  if(_buffer.size() - before > _max_size) {
+    throw_error(std::errc::value_too_large, "ciri: async item exceeds maximum size");
+  }
+}
+
+// Function: _put
+// Encodes an item into the buffer if it is sent whole, and returns false 
+// for the containers and the large contiguous data _save walks itself.
+template <typename Sink, typename SizeType>
+template <typename T>
+bool AsyncSerializer<Sink, SizeType>::_put(const T& t) {
+
+  using U = std::decay_t<T>;
+
+  if constexpr(async_layout<U>() != AsyncLayout::WHOLE && async_layout<U>() != AsyncLayout::CONTIGUOUS) {
+    return false;
+  }
+  else {
+
+    if constexpr(async_layout<U>() == AsyncLayout::CONTIGUOUS) {
+      if(t.size() * sizeof(typename U::value_type) >= _high_water) {
+        return false;
+      }
+    }
+
+    _encode(t);
+    return true;
+  }
+}
+
+// Function: _save
+template <typename Sink, typename SizeType>
+template <typename T>
+Task<> AsyncSerializer<Sink, SizeType>::_save(const T& t) {
   
+  using U = std::decay_t<T>;
+
+  Serializer<OutputBuffer, SizeType> ar(_buffer);
+
+  if(!_put(t)) {
+    // contiguous arithmetic data above the high-water mark, sent in place 
+    // after its size tag
+    if constexpr(async_layout<U>() == AsyncLayout::CONTIGUOUS) {
+      ar(make_size_tag(t.size()));
+      co_await _drain();
+      co_await _write_chunk(reinterpret_cast<const char*>(t.data()), t.size() * sizeof(typename U::value_type));
+    }
+    // containers of compound elements, encoded element by element
+    else if constexpr(async_layout<U>() == AsyncLayout::SEQUENCE || async_layout<U>() == AsyncLayout::SET) {
+      ar(make_size_tag(t.size()));
+      for(const auto& item : t) {
+        if(!_put(item)) {
+          co_await _save(item);
+        }
+        else if(_buffer.size() >= _high_water) {
+          co_await _drain();
+        }
+      }
+    }
+    else if constexpr(async_layout<U>() == AsyncLayout::MAP) {
+      ar(make_size_tag(t.size()));
+      for(const auto& [k, v] : t) {
+        _encode(k);
+        if(!_put(v)) {
+          co_await _save(v);
+        }
+        else if(_buffer.size() >= _high_water) {
+          co_await _drain();
+        }
+      }
+    }
+  }
+  
+  if(_buffer.size() >= _high_water) {
+    co_await _drain();
+  }
+}
+
+// Function: _write
+template <typename Sink, typename SizeType>
+Task<> AsyncSerializer<Sink, SizeType>::_write(const char* data, size_t n) {
+  while(n > 0) {
+    auto k = _sink.write_some(data, static_cast<std::streamsize>(n));
+    if(k > 0) {
+      data += k;
+      n -= k;
+    }
+    else {
+      co_await _sink.writable();
+    }
+  }
+}
+
+// Function: _write_chunk
+// Writes n bytes as chunks of at most max_size bytes.
+template <typename Sink, typename SizeType>
+Task<> AsyncSerializer<Sink, SizeType>::_write_chunk(const char* data, size_t n) {
+  while(n > 0) {
+    const uint32_t k = static_cast<uint32_t>(std::min<size_t>({n, _max_size, UINT32_MAX}));
+    co_await _write(reinterpret_cast<const char*>(&k), sizeof(k));
+    co_await _write(data, k);
+    _size += k;
+    data += k;
+    n -= k;
+  }
+}
+
+// Function: _drain
+template <typename Sink, typename SizeType>
+Task<> AsyncSerializer<Sink, SizeType>::_drain() {
+  co_await _write_chunk(_buffer.data(), _buffer.size());
+  _buffer.clear();
+}
+
+// Class: AsyncDeserializer
+// Deserializer that reads the frames of an AsyncSerializer from a 
+// non-blocking source, suspending on short reads. Items are decoded chunk 
+// by chunk as they arrive: an item encoded whole is decoded from the chunk 
+// holding it, contiguous arithmetic data is read from the source straight 
+// into its container, and containers are filled element by element. A 
+// chunk or an item encoded whole larger than max_size is rejected before 
+// allocating for it.
+template <typename Source, typename SizeType = std::streamsize>
+class AsyncDeserializer {
+
+  public:
+
+    AsyncDeserializer(Source& source, size_t max_size = 1 << 26) : 
+      _source(source), _max_size(max_size) {
+    }
+    
+    // Reads one frame into the items; they must outlive the returned task.
+    template <typename... T>
+    Task<SizeType> operator()(T&... items);
+
   private:
 
-    Device& _device;
+    Source& _source;
+
+    size_t _max_size;
     
-    template <typename T>
-    SizeType _load(T&&);
+    // received bytes of the frame not decoded yet, in [_pos, _limit)
+    std::vector<char, DefaultInitAllocator<char>> _chunk;
+    size_t _pos {0};
+    size_t _limit {0};
     
-    // Function: _variant_helper
-    template <size_t I = 0, typename... ArgsT, std::enable_if_t<I==sizeof...(ArgsT)>* = nullptr>
-    SizeType _variant_helper(size_t, std::variant<ArgsT...>&);
+    bool _ended {false};
+
+    uint64_t _size {0};
+
+    template <typename T>
+    bool _try(T&);
     
-    // Function: _variant_helper
-    template <size_t I = 0, typename... ArgsT, std::enable_if_t<I<sizeof...(ArgsT)>* = nullptr>
-    SizeType _variant_helper(size_t, std::variant<ArgsT...>&);
-};
+    template <typename T>
+    bool _decode(T&&);
 
-// Constructor
-template <typename Device, typename SizeType>
-Deserializer<Device, SizeType>::Deserializer(Device& device) : _device(device) {
-}
+    template <typename T>
+    Task<> _load(T&);
 
-// Operator ()
-template <typename Device, typename SizeType>
+    template <typename T>
+    Task<> _whole(T&&);
+
+    Task<> _more();
+    Task<> _fill(char*, size_t);
+};
+
+// Function: operator()
+template <typename Source, typename SizeType>
 template <typename... T>
-SizeType Deserializer<Device, SizeType>::operator() (T&&... items) {
-  return (_load(std::forward<T>(items)) + ...);
+Task<SizeType> AsyncDeserializer<Source, SizeType>::operator()(T&... items) {
+
+  _pos = _limit = 0;
+  _ended = false;
+  _size = 0;
+
+  (co_await _load(items), ...);
+
+  if(_pos != _limit) {
+    throw_error(std::errc::illegal_byte_sequence, "ciri: async frame size mismatch");
+  }
+
+  if(!_ended) {
+    uint32_t k;
+    co_await _fill(reinterpret_cast<char*>(&k), sizeof(k));
+    if(k != 0) {
+      throw_error(std::errc::illegal_byte_sequence, "ciri: async frame size mismatch");
+    }
+  }
+
+  co_return static_cast<SizeType>(_size);
 }
 
-// Function: _load
-template <typename Device, typename SizeType>
+// Function: _try
+// Decodes an item sent whole if the received bytes hold all of it, and 
+// returns false otherwise or for the items _load walks itself.
+template <typename Source, typename SizeType>
 template <typename T>
-SizeType Deserializer<Device, SizeType>::_load(T&& t) {
+bool AsyncDeserializer<Source, SizeType>::_try(T& t) {
 
   using U = std::decay_t<T>;
   
-  // arithmetic data type
-  if constexpr(std::is_arithmetic_v<U>) {
-    _device.read(reinterpret_cast<char*>(std::addressof(t)), sizeof(t));
-    return sizeof(t);
+  if constexpr(async_layout<U>() == AsyncLayout::CONTIGUOUS) {
+    typename U::size_type n;
+    if(_limit - _pos < sizeof(n)) {
+      return false;
+    }
+    std::memcpy(&n, _chunk.data() + _pos, sizeof(n));
+    if(n > (_limit - _pos - sizeof(n)) / sizeof(typename U::value_type)) {
+      return false;
+    }
+    return _decode(t);
   }
-  // std::basic_string
-  else if constexpr(is_std_basic_string_v<U>) {
-    typename U::size_type num_chars;
-    auto sz = _load(make_size_tag(num_chars));
-    t.resize(num_chars);
-    _device.read(reinterpret_cast<char*>(t.data()), num_chars*sizeof(typename U::value_type));
-    return sz + num_chars*sizeof(typename U::value_type);
+  else if constexpr(async_layout<U>() == AsyncLayout::WHOLE) {
+    return _decode(t);
   }
-  // std::vector
-  else if constexpr(is_std_vector_v<U>) {
-    typename U::size_type num_data;
-    if constexpr(std::is_arithmetic_v<typename U::value_type>) {
-      auto sz = _load(make_size_tag(num_data));
-      t.resize(num_data);
-      _device.read(reinterpret_cast<char*>(t.data()), num_data * sizeof(typename U::value_type));
-      return sz + num_data * sizeof(typename U::value_type);
-    } 
-    else {
-      auto sz = _load(make_size_tag(num_data));
-      t.resize(num_data);
-      for(auto && v : t) {
-        sz += _load(v);
-      }
-      return sz;
-    }
+  else {
+    return false;
   }
-  // std::deque, std::list, and std::forward_list
-  else if constexpr(is_std_deque_v<U> || is_std_list_v<U> || is_std_forward_list_v<U>) {
+}
 
-    typename U::size_type num_data;
-    auto sz = _load(make_size_tag(num_data));
+// Function: _decode
+// Decodes an item from the received bytes. The writer cuts chunks between 
+// items, so an item runs short only once it is split across chunks by 
+// max_size, and is decoded again after the next chunk; at the end of the 
+// frame, an item that runs short throws.
+template <typename Source, typename SizeType>
+template <typename T>
+bool AsyncDeserializer<Source, SizeType>::_decode(T&& t) {
 
-    t.resize(num_data);
-    for(auto && v : t) {
-      sz += _load(v);
-    }
-    return sz;
+  if(_pos == _limit && !_ended) {
+    return false;
   }
-  // std::map
-  else if constexpr(is_std_map_v<U>) {
 
-    typename U::size_type num_data;
-    auto sz = _load(make_size_tag(num_data));
-    
-    t.clear();
-    auto hint = t.begin();
-      
-    typename U::key_type k;
-    typename U::mapped_type v;
+  InputBuffer input(_chunk.data() + _pos, _limit - _pos);
+  Deserializer<InputBuffer, SizeType> ar(input);
 
-    for(size_t i=0; i<num_data; ++i) {
-      sz += _load(make_kv_pair(k, v));
-      hint = t.emplace_hint(hint, std::move(k), std::move(v));
+  try {
+    ar(std::forward<T>(t));
+  }
+  catch(const std::system_error&) {
+    if(_ended) {
+      throw;
     }
-    return sz;
+    return false;
   }
-  // std::unordered_map
-  else if constexpr(is_std_unordered_map_v<U>) {
-
-    typename U::size_type num_data;
-    auto sz = _load(make_size_tag(num_data));
 
-    t.clear();
-    t.reserve(num_data);
-
-    typename U::key_type k;
-    typename U::mapped_type v;
+  _pos = _limit - input.remaining();
+  return true;
+}
 
-    for(size_t i=0; i<num_data; ++i) {
-      sz += _load(make_kv_pair(k, v));
-      t.emplace(std::move(k), std::move(v));
-    }
-    
-    return sz;
+// Function: _whole
+// Decodes an item sent whole, receiving chunks until it is complete.
+template <typename Source, typename SizeType>
+template <typename T>
+Task<> AsyncDeserializer<Source, SizeType>::_whole(T&& t) {
+  while(!_decode(t)) {
+    co_await _more();
   }
-  // std::set
-  else if constexpr(is_std_set_v<U>) {
+}
 
-    typename U::size_type num_data;
-    auto sz = _load(make_size_tag(num_data));
+// Function: _load
+template <typename Source, typename SizeType>
+template <typename T>
+Task<> AsyncDeserializer<Source, SizeType>::_load(T& t) {
 
-    t.clear();
-    auto hint = t.begin();
-      
-    typename U::key_type k;
+  using U = std::decay_t<T>;
 
-    for(size_t i=0; i<num_data; ++i) {   
-      sz += _load(k);
-      hint = t.emplace_hint(hint, std::move(k));
-    }   
-    return sz;
-  }
-  // std::unordered_set
-  else if constexpr(is_std_unordered_set_v<U>) {
+  // contiguous arithmetic data, copied from the received bytes or read from
+  // the source into the container, which grows as the chunks arrive
+  if constexpr(async_layout<U>() == AsyncLayout::CONTIGUOUS) {
+    
+    using V = typename U::value_type;
 
-    typename U::size_type num_data;
-    auto sz = _load(make_size_tag(num_data));
+    typename U::size_type n;
+    co_await _whole(make_size_tag(n));
 
-    t.clear();
-    t.reserve(num_data);
-      
-    typename U::key_type k;
+    if(n > std::numeric_limits<size_t>::max() / sizeof(V)) {
+      throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted async size");
+    }
+    
+    const size_t num_bytes = n * sizeof(V);
+    size_t done = std::min(num_bytes, _limit - _pos);
+    
+    t.resize((done + sizeof(V) - 1) / sizeof(V));
+    if(done) {
+      std::memcpy(reinterpret_cast<char*>(t.data()), _chunk.data() + _pos, done);
+      _pos += done;
+    }
 
-    for(size_t i=0; i<num_data; ++i) {   
-      sz += _load(k);
-      t.emplace(std::move(k));
-    }   
-    return sz;
-  }
-  // enum
-  else if constexpr(std::is_enum_v<U>) {
-    std::underlying_type_t<U> k;
-    auto sz = _load(k);
-    t = static_cast<U>(k);
-    return sz;
-  }
-  // std::array
-  else if constexpr(is_std_array_v<U>) {
-    static_assert(std::tuple_size<U>::value > 0, "Array size can't be zero");
-      
-    if constexpr(std::is_arithmetic_v<typename U::value_type>) {
-      _device.read(reinterpret_cast<char*>(t.data()), sizeof(t));
-      return sizeof(t);
-    } 
-    else {
-      SizeType sz {0};
-      for(auto && v : t) {
-        sz += _load(v);
+    while(done < num_bytes) {
+      uint32_t k;
+      co_await _fill(reinterpret_cast<char*>(&k), sizeof(k));
+      if(k == 0 || k > _max_size) {
+        throw_error(std::errc::illegal_byte_sequence, "ciri: corrupted async chunk");
+      }
+      _size += k;
+      const size_t m = std::min<size_t>(k, num_bytes - done);
+      t.resize((done + m + sizeof(V) - 1) / sizeof(V));
+      co_await _fill(reinterpret_cast<char*>(t.data()) + done, m);
+      done += m;
+      // the rest of a chunk that runs past the data is kept
+      if(m < k) {
+        _chunk.resize(k - m);
+        co_await _fill(_chunk.data(), k - m);
+        _pos = 0;
+        _limit = k - m;
       }
-      return sz;
     }
   }
-  // std::variant
-  else if constexpr(is_std_variant_v<U>) {
-    std::decay_t<decltype(t.index())> idx;
-    auto s = _load(idx);
-    return s + _variant_helper(idx, t);
-  }
-  // std::duration
-  else if constexpr(is_std_duration_v<U>) {
-    typename U::rep count;
-    auto s = _load(count);
-    t = U{count};
-    return s;
-  }
-  // std::time_point
-  else if constexpr(is_std_time_point_v<U>) {
-    typename U::duration elapsed;
-    auto s = _load(elapsed);
-    t = U{elapsed};
-    return s;
-  }
-  // std::optional
-  else if constexpr(is_std_optional_v<U>) {
-    bool has_value;
-    auto s = _load(has_value);
-    if(has_value) {
-      if(!t) {
-        t = typename U::value_type();
+  // containers of compound elements, filled element by element
+  else if constexpr(async_layout<U>() == AsyncLayout::SEQUENCE) {
+    typename U::size_type n;
+    co_await _whole(make_size_tag(n));
+    t.clear();
+    for(typename U::size_type i=0; i<n; ++i) {
+      auto& item = t.emplace_back();
+      if(!_try(item)) {
+        co_await _load(item);
       }
-      s += _load(*t);
     }
-    else {
-      t.reset(); 
+  }
+  else if constexpr(async_layout<U>() == AsyncLayout::SET) {
+    typename U::size_type n;
+    co_await _whole(make_size_tag(n));
+    t.clear();
+    for(typename U::size_type i=0; i<n; ++i) {
+      typename U::value_type k;
+      if(!_try(k)) {
+        co_await _load(k);
+      }
+      t.insert(std::move(k));
     }
-    return s;
   }
-  // std::tuple
-  else if constexpr(is_std_tuple_v<U>) {
-    return std::apply(
-      [this] (auto&&... args) {
-        return (_load(std::forward<decltype(args)>(args)) + ... + 0); 
-      },
-      std::forward<T>(t)
-    );
+  else if constexpr(async_layout<U>() == AsyncLayout::MAP) {
+    typename U::size_type n;
+    co_await _whole(make_size_tag(n));
+    t.clear();
+    for(typename U::size_type i=0; i<n; ++i) {
+      typename U::key_type k;
+      typename U::mapped_type v;
+      if(!_decode(k)) {
+        co_await _whole(k);
+      }
+      if(!_try(v)) {
+        co_await _load(v);
+      }
+      t.emplace(std::move(k), std::move(v));
+    }
   }
   else {
-    return t.load(*this);
+    co_await _whole(t);
   }
 }
+
+// Function: _more
+// Receives the next chunk behind the bytes not decoded yet, or marks the 
+// end of the frame.
+template <typename Source, typename SizeType>
+Task<> AsyncDeserializer<Source, SizeType>::_more() {
+
+  if(_ended) {
+    throw_error(std::errc::illegal_byte_sequence, "ciri: async frame size mismatch");
+  }
+
+  uint32_t k;
+  co_await _fill(reinterpret_cast<char*>(&k), sizeof(k));
   
-// Function: _variant_helper
-template <typename Device, typename SizeType>
-template <size_t I, typename... ArgsT, std::enable_if_t<I==sizeof...(ArgsT)>*>
-SizeType Deserializer<Device, SizeType>::_variant_helper(size_t i, std::variant<ArgsT...>& v) {
-  return 0;
+  if(k == 0) {
+    _ended = true;
+    co_return;
+  }
+
+  const size_t rest = _limit - _pos;
+
+  if(k > _max_size || rest > _max_size) {
+    throw_error(std::errc::value_too_large, "ciri: async item exceeds maximum size");
+  }
+
+  if(rest) {
+    std::memmove(_chunk.data(), _chunk.data() + _pos, rest);
+  }
+  _chunk.resize(rest + k);
+  co_await _fill(_chunk.data() + rest, k);
+  
+  _pos = 0;
+  _limit = rest + k;
+  _size += k;
 }
 
-// Function: _variant_helper
-template <typename Device, typename SizeType>
-template <size_t I, typename... ArgsT, std::enable_if_t<I<sizeof...(ArgsT)>*>
-SizeType Deserializer<Device, SizeType>::_variant_helper(size_t i, std::variant<ArgsT...>& v) {
-  if(i == 0) {
-    using type = ExtractType_t<I, std::variant<ArgsT...>>;
-    if(v.index() != I) {
-      static_assert(
-        std::is_default_constructible<type>::value, 
-        "Failed to archive variant (type should be default constructible T())"
-      );
-      v = type();
+// Function: _fill
+// Reads exactly n bytes, so nothing past the frame is taken from the source.
+template <typename Source, typename SizeType>
+Task<> AsyncDeserializer<Source, SizeType>::_fill(char* data, size_t n) {
+  for(size_t i=0; i<n; ) {
+    auto k = _source.read_some(data + i, static_cast<std::streamsize>(n - i));
+    if(k > 0) {
+      i += k;
+    }
+    else if(k == 0) {
+      co_await _source.readable();
+    }
+    else {
+      throw_error(std::errc::result_out_of_range, "ciri: unexpected end of async stream");
     }
-    return _load(std::get<type>(v));
   }
-  return _variant_helper<I+1, ArgsT...>(i-1, v);
 }
 
+#endif
+
 }; // ned of namespace ciri ---------------------------------------------------
 
 
@@ -3,6 +3,9 @@
 #include <doctest.h>
 #include <ciri.hpp>
 #include <random>
+#include <atomic>
+#include <cstdlib>
+#include <memory_resource>
 
 // ----------------------------------------------------------------------------
 // Random generator utilities
@@ -620,6 +623,2394 @@ void test_optional() {
   }
 }
 
+// Procedure: test_optionals
+void test_optionals() {
+
+  for(auto i=0; i<1024; ++i) {
+
+    const size_t num_data = random<size_t>(0, 1024);
+
+    std::vector<std::optional<float>> o_floats(num_data), i_floats;
+    std::vector<std::optional<std::string>> o_strs(num_data), i_strs(3);
+    std::array<std::optional<int>, 13> o_ints, i_ints;
+    std::vector<std::optional<bool>> o_bools(num_data), i_bools;
+
+    size_t num_floats = 0;
+    for(auto& v : o_floats) if(random<int>(0, 3) == 0) { v = random<float>(); ++num_floats; }
+    for(auto& v : o_strs) if(random<int>(0, 1) == 0) v = random<std::string>();
+    for(auto& v : o_ints) if(random<int>(0, 1) == 0) v = random<int>();
+    for(auto& v : i_ints) if(random<int>(0, 1) == 0) v = random<int>();
+    for(auto& v : o_bools) if(random<int>(0, 1) == 0) v = (random<int>(0, 1) == 0);
+
+    // Output archiver
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(o_floats, o_strs, o_ints, o_bools);
+
+    // Input archiver
+    std::istringstream is(os.str());
+    ciri::Deserializer iar(is);
+    auto isz = iar(i_floats, i_strs, i_ints, i_bools);
+    REQUIRE(0 == is.rdbuf()->in_avail());
+    REQUIRE(osz == isz);
+
+    REQUIRE(o_floats == i_floats);
+    REQUIRE(o_strs == i_strs);
+    REQUIRE(o_ints == i_ints);
+    REQUIRE(o_bools == i_bools);
+
+    // validity bitmap followed by the dense present values
+    std::ostringstream fos;
+    ciri::Serializer foar(fos);
+    REQUIRE(foar(o_floats) == sizeof(size_t) + (num_data + 7)/8 + num_floats*sizeof(float));
+  }
+}
+
+// Procedure: test_rle
+void test_rle() {
+
+  for(auto i=0; i<256; ++i) {
+
+    const size_t num_data = random<size_t>(0, 4096);
+
+    std::vector<uint8_t> o_mask(num_data), i_mask;
+    std::vector<int16_t> o_sensor, i_sensor;
+    std::vector<double>  o_noise(num_data), i_noise;
+    std::array<uint32_t, 1024> o_ids, i_ids;
+
+    for(size_t j=0; j<num_data; ) {
+      auto len = random<size_t>(1, 512);
+      auto v = random<uint8_t>(0, 1);
+      for(size_t k=0; k<len && j<num_data; ++k, ++j) o_mask[j] = v;
+    }
+    while(o_sensor.size() < num_data) {
+      o_sensor.resize(std::min(num_data, o_sensor.size() + random<size_t>(1, 100)), random<int16_t>());
+    }
+    for(auto& v : o_noise) v = random<double>();
+    for(size_t j=0; j<o_ids.size(); ++j) o_ids[j] = static_cast<uint32_t>(j / 100);
+
+    // Output archiver
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(
+      ciri::make_rle(o_mask), ciri::make_rle(o_sensor), ciri::make_rle(o_noise), ciri::make_rle(o_ids)
+    );
+
+    // Input archiver
+    std::istringstream is(os.str());
+    ciri::Deserializer iar(is);
+    auto isz = iar(
+      ciri::make_rle(i_mask), ciri::make_encoded(i_sensor), ciri::make_rle(i_noise), ciri::make_rle(i_ids)
+    );
+    REQUIRE(0 == is.rdbuf()->in_avail());
+    REQUIRE(osz == isz);
+
+    REQUIRE(o_mask == i_mask);
+    REQUIRE(o_sensor == i_sensor);
+    REQUIRE(o_noise == i_noise);
+    REQUIRE(o_ids == i_ids);
+
+    // poorly compressible data falls back to raw plus a one-byte tag
+    std::ostringstream nos;
+    ciri::Serializer noar(nos);
+    REQUIRE(noar(ciri::make_rle(o_noise)) == sizeof(size_t) + 1 + num_data*sizeof(double));
+    
+    std::ostringstream ios;
+    ciri::Serializer ioar(ios);
+    REQUIRE(ioar(ciri::make_rle(o_ids)) == 1 + sizeof(size_t) + 11*(sizeof(uint32_t) + sizeof(uint32_t)));
+  }
+}
+
+// Procedure: test_encoding
+template <typename T>
+void test_encoding(const std::vector<T>& o_data, ciri::Encoding encoding, float preference = 0.5f) {
+
+  std::ostringstream os;
+  ciri::Serializer oar(os);
+  auto osz = oar(ciri::make_encoded(o_data, encoding, preference));
+  
+  std::vector<T> i_data;
+  std::istringstream is(os.str());
+  ciri::Deserializer iar(is);
+  auto isz = iar(ciri::make_encoded(i_data));
+
+  REQUIRE(0 == is.rdbuf()->in_avail());
+  REQUIRE(osz == isz);
+  REQUIRE(o_data == i_data);
+}
+
+// Function: adaptive_tag
+// Returns the encoding tag the adaptive mode writes after the size.
+template <typename T>
+ciri::Encoding adaptive_tag(const std::vector<T>& data, float preference = 1.0f) {
+  std::ostringstream os;
+  ciri::Serializer oar(os);
+  oar(ciri::make_adaptive(data, preference));
+  return static_cast<ciri::Encoding>(os.str()[sizeof(size_t)]);
+}
+
+// Procedure: test_adaptive
+void test_adaptive() {
+
+  for(auto i=0; i<64; ++i) {
+
+    const size_t num_data = random<size_t>(1000, 10000);
+
+    std::vector<uint64_t> timestamps(num_data);
+    std::vector<int32_t>  levels(num_data);
+    std::vector<int16_t>  mostly_zero(num_data, 0);
+    std::vector<int64_t>  wide(num_data);
+    std::vector<double>   noise(num_data);
+
+    uint64_t ts = 1700000000000000000ull;
+    for(auto& v : timestamps) v = (ts += random<uint64_t>(900, 1100));
+    for(auto& v : levels) v = random<int32_t>(-60, 60);
+    for(size_t j=random<size_t>(0, 200); j<num_data; j+=random<size_t>(200, 400)) mostly_zero[j] = random<int16_t>();
+    for(auto& v : wide) v = random<int64_t>();
+    for(auto& v : noise) v = random<double>();
+
+    REQUIRE(adaptive_tag(timestamps) == ciri::Encoding::DELTA);
+    REQUIRE(adaptive_tag(levels) == ciri::Encoding::FOR);
+    REQUIRE(adaptive_tag(mostly_zero) == ciri::Encoding::RLE);
+    REQUIRE(adaptive_tag(wide) == ciri::Encoding::RAW);
+    REQUIRE(adaptive_tag(noise) == ciri::Encoding::RAW);
+
+    for(auto p : {0.0f, 0.5f, 1.0f}) {
+      test_encoding(timestamps, ciri::Encoding::ADAPTIVE, p);
+      test_encoding(levels, ciri::Encoding::ADAPTIVE, p);
+      test_encoding(mostly_zero, ciri::Encoding::ADAPTIVE, p);
+      test_encoding(wide, ciri::Encoding::ADAPTIVE, p);
+      test_encoding(noise, ciri::Encoding::ADAPTIVE, p);
+    }
+    
+    for(auto e : {ciri::Encoding::VARINT, ciri::Encoding::DELTA, ciri::Encoding::FOR}) {
+      test_encoding(timestamps, e);
+      test_encoding(levels, e);
+      test_encoding(mostly_zero, e);
+      test_encoding(wide, e);
+      test_encoding(noise, e);
+      test_encoding(std::vector<int8_t>{-128, 127, 0, -1, 1}, e);
+      test_encoding(std::vector<char>{'a', 'b', 'c'}, e);
+      test_encoding(std::vector<uint8_t>(100, 255), e);
+    }
+  }
+}
+
+// Procedure: test_shuffle
+template <typename T>
+void test_shuffle() {
+
+  for(auto i=0; i<256; ++i) {
+
+    const size_t num_data = random<size_t>(0, 1000);
+
+    std::vector<T> o_data(num_data);
+    std::array<T, 37> o_arr;
+    for(auto& v : o_data) v = random<T>();
+    for(auto& v : o_arr) v = random<T>();
+
+    // byte planes
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(ciri::make_shuffle(o_data), ciri::make_bitshuffle(o_data), ciri::make_bitshuffle(o_arr));
+    REQUIRE(osz == 2*(sizeof(size_t) + 1 + num_data*sizeof(T)) + 1 + sizeof(o_arr));
+
+    auto bytes = os.str();
+    auto planes = reinterpret_cast<const uint8_t*>(bytes.data()) + sizeof(size_t) + 1;
+    auto values = reinterpret_cast<const uint8_t*>(o_data.data());
+    for(size_t j=0; j<num_data; ++j) {
+      for(size_t b=0; b<sizeof(T); ++b) {
+        REQUIRE(planes[b*num_data + j] == values[j*sizeof(T) + b]);
+      }
+    }
+
+    // bit planes: bit k of byte 8m+j of byte plane b is bit j of byte m of bit plane k
+    auto bitplanes = planes + num_data*sizeof(T) + sizeof(size_t) + 1;
+    const size_t G = num_data / 8;
+    for(size_t b=0; b<sizeof(T); ++b) {
+      for(size_t j=0; j<G*8; ++j) {
+        for(size_t k=0; k<8; ++k) {
+          REQUIRE(((planes[b*num_data + j] >> k) & 1) == ((bitplanes[b*num_data + k*G + j/8] >> (j%8)) & 1));
+        }
+      }
+    }
+
+    std::vector<T> i_data1, i_data2;
+    std::array<T, 37> i_arr;
+    std::istringstream is(bytes);
+    ciri::Deserializer iar(is);
+    auto isz = iar(ciri::make_encoded(i_data1), ciri::make_encoded(i_data2), ciri::make_encoded(i_arr));
+
+    REQUIRE(0 == is.rdbuf()->in_avail());
+    REQUIRE(osz == isz);
+    REQUIRE(o_data == i_data1);
+    REQUIRE(o_data == i_data2);
+    REQUIRE(o_arr == i_arr);
+  }
+}
+
+// Procedure: test_compression
+void test_compression() {
+
+  for(size_t block_size : {size_t{7}, size_t{1000}, size_t{1 << 16}}) {
+    for(auto i=0; i<16; ++i) {
+
+      const size_t num_data = random<size_t>(0, 50000);
+
+      std::vector<int32_t> o_levels(num_data);
+      std::vector<std::string> o_words(num_data / 10);
+      std::vector<double> o_noise(num_data / 10);
+      std::map<int, std::string> o_map;
+
+      for(auto& v : o_levels) v = random<int32_t>(0, 3);
+      for(auto& v : o_words) v = random<std::string>('a', 'd', random<size_t>(0, 40));
+      for(auto& v : o_noise) v = random<double>();
+      for(size_t j=0; j<num_data/100; ++j) o_map[random<int>()] = random<std::string>();
+
+      std::ostringstream os;
+      ciri::CompressedOutput co(os, block_size);
+      ciri::Serializer oar(co);
+      auto osz = oar(o_levels, o_words, o_noise, o_map);
+      co.flush();
+
+      if(block_size > 1000 && num_data > 1000) {
+        REQUIRE(os.str().size() < static_cast<size_t>(osz));
+      }
+
+      std::vector<int32_t> i_levels;
+      std::vector<std::string> i_words;
+      std::vector<double> i_noise;
+      std::map<int, std::string> i_map;
+
+      std::istringstream is(os.str());
+      ciri::CompressedInput ci(is);
+      ciri::Deserializer iar(ci);
+      auto isz = iar(i_levels, i_words, i_noise, i_map);
+
+      REQUIRE(0 == is.rdbuf()->in_avail());
+      REQUIRE(osz == isz);
+      REQUIRE(o_levels == i_levels);
+      REQUIRE(o_words == i_words);
+      REQUIRE(o_noise == i_noise);
+      REQUIRE(o_map == i_map);
+    }
+  }
+
+  // corrupted blocks are reported instead of decoded
+  std::ostringstream os;
+  {
+    ciri::CompressedOutput co(os);
+    ciri::Serializer oar(co);
+    oar(std::vector<int>(10000, 7));
+  }
+  auto bytes = os.str();
+  bytes[bytes.size() / 2] ^= 0x5A;
+  
+  std::vector<int> data;
+  std::istringstream is(bytes);
+  ciri::CompressedInput ci(is);
+  ciri::Deserializer iar(ci);
+  REQUIRE_THROWS_AS(iar(data), std::system_error);
+
+  // blocks longer than the configured maximum are rejected before allocating
+  std::istringstream lis(os.str());
+  ciri::CompressedInput lci(lis, 1024);
+  ciri::Deserializer liar(lci);
+  REQUIRE_THROWS_AS(liar(data), std::system_error);
+
+  uint32_t huge[2] = { 0xFFFFFFFFu, 16 };
+  std::istringstream his(std::string(reinterpret_cast<const char*>(huge), sizeof(huge)));
+  ciri::CompressedInput hci(his);
+  ciri::Deserializer hiar(hci);
+  REQUIRE_THROWS_AS(hiar(data), std::system_error);
+
+  // larger block sizes are clamped to what the default reader accepts
+  std::ostringstream cos;
+  std::vector<char> zeros(1 << 16, 0);
+  const size_t num_zeros = ciri::CompressedOutput<std::ostream>::MAX_BLOCK_SIZE + zeros.size();
+  {
+    ciri::CompressedOutput co(cos, size_t{1} << 30);
+    for(size_t k=0; k<num_zeros; k+=zeros.size()) {
+      co.write(zeros.data(), zeros.size());
+    }
+  }
+  uint32_t header[2];
+  std::memcpy(header, cos.str().data(), sizeof(header));
+  REQUIRE(header[0] == ciri::CompressedOutput<std::ostream>::MAX_BLOCK_SIZE);
+
+  std::istringstream cis(cos.str());
+  ciri::CompressedInput cci(cis);
+  for(size_t k=0; k<num_zeros; k+=zeros.size()) {
+    cci.read(zeros.data(), zeros.size());
+    REQUIRE(std::count(zeros.begin(), zeros.end(), 0) == static_cast<ptrdiff_t>(zeros.size()));
+  }
+  REQUIRE(0 == cis.rdbuf()->in_avail());
+}
+
+// Procedure: test_crc32c
+void test_crc32c() {
+
+  REQUIRE(ciri::crc32c("123456789", 9) == 0xE3069283);
+  REQUIRE(ciri::crc32c("", 0) == 0);
+
+  std::string bytes(100000, ' ');
+  for(auto& c : bytes) c = random<char>();
+
+  for(auto i=0; i<256; ++i) {
+    auto beg = random<size_t>(0, 64);
+    auto len = random<size_t>(0, i < 128 ? 64 : bytes.size() - beg);
+    auto sw = ~ciri::crc32c_sw(~0u, bytes.data() + beg, len);
+    REQUIRE(ciri::crc32c(bytes.data() + beg, len) == sw);
+    
+    // continuation and combination
+    auto mid = random<size_t>(0, len);
+    auto head = ciri::crc32c(bytes.data() + beg, mid);
+    REQUIRE(ciri::crc32c(bytes.data() + beg + mid, len - mid, head) == sw);
+    auto tail = ciri::crc32c_sw(0, bytes.data() + beg + mid, len - mid);
+    REQUIRE(~(ciri::crc32c_shift(~head, len - mid) ^ tail) == sw);
+  }
+}
+
+// Procedure: test_checksum
+void test_checksum() {
+
+  for(size_t block_size : {size_t{5}, size_t{4096}, size_t{1 << 16}}) {
+    for(auto i=0; i<16; ++i) {
+
+      std::vector<double> o_values(random<size_t>(0, 20000));
+      std::vector<std::string> o_words(random<size_t>(0, 100));
+      for(auto& v : o_values) v = random<double>();
+      for(auto& v : o_words) v = random<std::string>();
+
+      // checksum framing over compressed blocks
+      std::ostringstream os;
+      ciri::ChecksumOutput cko(os, block_size);
+      ciri::CompressedOutput co(cko);
+      ciri::Serializer oar(co);
+      auto osz = oar(o_values, o_words);
+      co.flush();
+      cko.flush();
+
+      std::vector<double> i_values;
+      std::vector<std::string> i_words;
+
+      std::istringstream is(os.str());
+      ciri::ChecksumInput cki(is);
+      ciri::CompressedInput ci(cki);
+      ciri::Deserializer iar(ci);
+      auto isz = iar(i_values, i_words);
+
+      REQUIRE(0 == is.rdbuf()->in_avail());
+      REQUIRE(osz == isz);
+      REQUIRE(o_values == i_values);
+      REQUIRE(o_words == i_words);
+
+      // any flipped bit is detected before decoding
+      auto bytes = os.str();
+      auto pos = random<size_t>(0, bytes.size() - 1);
+      bytes[pos] ^= static_cast<char>(1 << random<int>(0, 7));
+
+      std::istringstream cis(bytes);
+      ciri::ChecksumInput ccki(cis);
+      ciri::CompressedInput cci(ccki);
+      ciri::Deserializer ciar(cci);
+      std::vector<double> c_values;
+      std::vector<std::string> c_words;
+      REQUIRE_THROWS_AS(ciar(c_values, c_words), std::system_error);
+    }
+  }
+
+  // larger block sizes are clamped to what the default reader accepts
+  std::ostringstream os;
+  std::vector<char> bytes(1 << 16, 'c');
+  const size_t num_bytes = ciri::ChecksumOutput<std::ostream>::MAX_BLOCK_SIZE + bytes.size();
+  {
+    ciri::ChecksumOutput cko(os, size_t{1} << 30);
+    for(size_t k=0; k<num_bytes; k+=bytes.size()) {
+      cko.write(bytes.data(), bytes.size());
+    }
+  }
+  uint32_t header[2];
+  std::memcpy(header, os.str().data(), sizeof(header));
+  REQUIRE(header[0] == ciri::ChecksumOutput<std::ostream>::MAX_BLOCK_SIZE);
+
+  std::istringstream is(os.str());
+  ciri::ChecksumInput cki(is);
+  for(size_t k=0; k<num_bytes; k+=bytes.size()) {
+    cki.read(bytes.data(), bytes.size());
+    REQUIRE(std::count(bytes.begin(), bytes.end(), 'c') == static_cast<ptrdiff_t>(bytes.size()));
+  }
+  REQUIRE(0 == is.rdbuf()->in_avail());
+}
+
+// Procedure: test_quantized
+void test_quantized() {
+
+  // scalar half conversions
+  REQUIRE(ciri::float_to_half(1.0f) == 0x3C00);
+  REQUIRE(ciri::float_to_half(-2.0f) == 0xC000);
+  REQUIRE(ciri::float_to_half(65504.0f) == 0x7BFF);
+  REQUIRE(ciri::float_to_half(65520.0f) == 0x7C00);
+  REQUIRE(ciri::float_to_half(std::ldexp(1.0f, -24)) == 0x0001);
+  REQUIRE(ciri::float_to_half(std::numeric_limits<float>::infinity()) == 0x7C00);
+  REQUIRE(std::isnan(ciri::half_to_float(ciri::float_to_half(std::nanf("")))));
+
+  for(uint32_t h=0; h<65536; ++h) {
+    float f = ciri::half_to_float(static_cast<uint16_t>(h));
+    if(!std::isnan(f)) {
+      REQUIRE(ciri::float_to_half(f) == h);
+    }
+  }
+
+  // vectorized paths agree with the scalar ones
+  std::vector<float> values(1027);
+  for(auto& v : values) v = random<float>(-70000.0f, 70000.0f);
+  values[3] = std::nanf("");
+  values[17] = -std::numeric_limits<float>::infinity();
+  values[18] = 1e-6f;
+
+  std::vector<uint16_t> halves(values.size());
+  std::vector<float> decoded(values.size());
+
+  ciri::fp16_encode(values.data(), values.size(), halves.data());
+  ciri::fp16_decode(halves.data(), halves.size(), decoded.data());
+  for(size_t i=0; i<values.size(); ++i) {
+    REQUIRE(halves[i] == ciri::float_to_half(values[i]));
+    float f = ciri::half_to_float(halves[i]);
+    REQUIRE(std::memcmp(&decoded[i], &f, sizeof(float)) == 0);
+  }
+
+  ciri::bf16_encode(values.data(), values.size(), halves.data());
+  ciri::bf16_decode(halves.data(), halves.size(), decoded.data());
+  for(size_t i=0; i<values.size(); ++i) {
+    REQUIRE(halves[i] == ciri::float_to_bf16(values[i]));
+    float f = ciri::bf16_to_float(halves[i]);
+    REQUIRE(std::memcmp(&decoded[i], &f, sizeof(float)) == 0);
+    if(std::isfinite(values[i])) {
+      REQUIRE(std::fabs(decoded[i] - values[i]) <= std::fabs(values[i]) / 256);
+    }
+  }
+
+  // int8 blocks: only infinities, infinities among zeros and NaN, and 
+  // infinities among finite values
+  const float inf = std::numeric_limits<float>::infinity();
+  std::vector<float> o_int8(3 * 256 + 20, 0.0f);
+  for(size_t j=0; j<256; ++j) {
+    o_int8[j] = (j % 3) ? inf : -inf;
+  }
+  o_int8[256 + 5] = inf;
+  o_int8[256 + 6] = std::nanf("");
+  o_int8[256 + 40] = -inf;
+  for(size_t j=512; j<o_int8.size(); ++j) {
+    o_int8[j] = random<float>(-1.0f, 1.0f);
+  }
+  o_int8[512 + 7] = inf;
+  o_int8[512 + 260] = -inf;
+
+  std::vector<float> scales((o_int8.size() + 255) / 256);
+  std::vector<int8_t> codes(o_int8.size());
+  std::vector<float> i_int8(o_int8.size());
+  ciri::int8_encode(o_int8.data(), o_int8.size(), scales.data(), codes.data());
+  ciri::int8_decode(scales.data(), codes.data(), codes.size(), i_int8.data());
+  for(size_t j=0; j<o_int8.size(); ++j) {
+    if(std::isinf(o_int8[j])) {
+      REQUIRE(codes[j] == (o_int8[j] > 0 ? 127 : -127));
+    }
+    if(j < 512) {
+      // no finite scale applies, so the values come back as they were
+      REQUIRE((std::isnan(o_int8[j]) ? 0.0f : o_int8[j]) == i_int8[j]);
+    }
+    else if(std::isfinite(o_int8[j])) {
+      REQUIRE(std::fabs(i_int8[j] - o_int8[j]) <= scales[j / 256] / 2 * 1.001f);
+    }
+  }
+
+  for(auto i=0; i<64; ++i) {
+
+    const size_t num_data = random<size_t>(0, 2000);
+
+    std::vector<float> o_f(num_data);
+    std::vector<double> o_d(num_data);
+    std::array<float, 300> o_arr;
+    for(auto& v : o_f) v = random<float>(-10.0f, 10.0f);
+    for(auto& v : o_d) v = random<double>(-1e3, 1e3);
+    for(auto& v : o_arr) v = random<float>(-1.0f, 1.0f);
+
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(
+      ciri::make_quantized(o_f), 
+      ciri::make_quantized(o_d, ciri::Encoding::BF16),
+      ciri::make_quantized(o_arr, ciri::Encoding::INT8)
+    );
+    REQUIRE(osz == 2*(sizeof(size_t) + 1 + num_data*2) + 1 + 2*sizeof(float) + o_arr.size());
+    
+    std::vector<float> i_f;
+    std::vector<double> i_d;
+    std::array<float, 300> i_arr;
+    std::istringstream is(os.str());
+    ciri::Deserializer iar(is);
+    auto isz = iar(ciri::make_encoded(i_f), ciri::make_encoded(i_d), ciri::make_encoded(i_arr));
+
+    REQUIRE(0 == is.rdbuf()->in_avail());
+    REQUIRE(osz == isz);
+    REQUIRE(i_f.size() == num_data);
+    REQUIRE(i_d.size() == num_data);
+
+    for(size_t j=0; j<num_data; ++j) {
+      REQUIRE(std::fabs(i_f[j] - o_f[j]) <= std::max(std::fabs(o_f[j]) / 1024, 1e-4f));
+      REQUIRE(std::fabs(i_d[j] - o_d[j]) <= std::fabs(o_d[j]) / 256 + 1e-30);
+    }
+    
+    // per-block scale bounds the error by half a step
+    for(size_t b=0; b<o_arr.size(); b+=256) {
+      float amax = 0.0f;
+      for(size_t j=b; j<std::min(b + 256, o_arr.size()); ++j) {
+        amax = std::max(amax, std::fabs(o_arr[j]));
+      }
+      for(size_t j=b; j<std::min(b + 256, o_arr.size()); ++j) {
+        REQUIRE(std::fabs(i_arr[j] - o_arr[j]) <= amax / 254 * 1.001f);
+      }
+    }
+  }
+
+  // adaptive selection never picks a lossy encoding
+  std::vector<float> o_f(1000, 1.5f);
+  std::ostringstream os;
+  ciri::Serializer oar(os);
+  oar(ciri::make_adaptive(o_f, 0.0f));
+  std::vector<float> i_f;
+  std::istringstream is(os.str());
+  ciri::Deserializer iar(is);
+  iar(ciri::make_encoded(i_f));
+  REQUIRE(o_f == i_f);
+}
+
+// Procedure: test_bits
+struct BitFields {
+
+  enum class Kind : uint8_t { A, B, C, D, E };
+
+  bool     flag   = random<int>(0, 1);
+  Kind     kind   = static_cast<Kind>(random<int>(0, 4));
+  int8_t   delta  = random<int8_t>(-16, 15);
+  uint16_t length = random<uint16_t>(0, 4095);
+  int32_t  offset = random<int32_t>(-(1 << 26), (1 << 26) - 1);
+  uint64_t stamp  = random<uint64_t>(0, (uint64_t{1} << 40) - 1);
+  uint64_t wide   = random<uint64_t>();
+  double   value  = random<double>();
+  int16_t  tail   = random<int16_t>(-64, 63);
+
+  template <typename ArchiverT>
+  auto save(ArchiverT& ar) const {
+    return ar(
+      ciri::make_bits<1>(flag),
+      ciri::make_bits<3>(kind),
+      ciri::make_bits<5>(delta),
+      ciri::make_bits<12>(length),
+      ciri::make_bits<27>(offset),
+      ciri::make_bits<40>(stamp),
+      ciri::make_bits<64>(wide),
+      value,
+      ciri::make_bits<7>(tail)
+    );
+  }
+  
+  template <typename ArchiverT>
+  auto load(ArchiverT& ar) {
+    return ar(
+      ciri::make_bits<1>(flag),
+      ciri::make_bits<3>(kind),
+      ciri::make_bits<5>(delta),
+      ciri::make_bits<12>(length),
+      ciri::make_bits<27>(offset),
+      ciri::make_bits<40>(stamp),
+      ciri::make_bits<64>(wide),
+      value,
+      ciri::make_bits<7>(tail)
+    );
+  }
+
+  bool operator == (const BitFields& rhs) const {
+    return flag == rhs.flag && kind == rhs.kind && delta == rhs.delta && 
+           length == rhs.length && offset == rhs.offset && stamp == rhs.stamp &&
+           wide == rhs.wide && value == rhs.value && tail == rhs.tail;
+  }
+};
+
+void test_bits() {
+
+  // 152 bits pack into two words and three bytes, then the double and one 
+  // byte for the trailing field
+  constexpr size_t packed_size = 19 + sizeof(double) + 1;
+
+  for(auto i=0; i<256; ++i) {
+
+    const size_t num_data = random<size_t>(0, 100);
+
+    BitFields o_one;
+    std::vector<BitFields> o_many(num_data);
+    
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(o_one, o_many);
+    REQUIRE(osz == packed_size * (num_data + 1) + sizeof(size_t));
+    REQUIRE(os.str().size() == static_cast<size_t>(osz));
+
+    BitFields i_one;
+    std::vector<BitFields> i_many;
+    std::istringstream is(os.str());
+    ciri::Deserializer iar(is);
+    auto isz = iar(i_one, i_many);
+
+    REQUIRE(0 == is.rdbuf()->in_avail());
+    REQUIRE(osz == isz);
+    REQUIRE(o_one == i_one);
+    REQUIRE(o_many == i_many);
+  }
+
+  // fields are packed LSB-first
+  std::ostringstream os;
+  ciri::Serializer oar(os);
+  REQUIRE(oar(ciri::make_bits<4>(uint8_t{0x5}), ciri::make_bits<8>(uint8_t{0xAB})) == 2);
+  REQUIRE(os.str() == std::string("\xB5\x0A", 2));
+}
+
+// Procedure: test_views
+void test_views() {
+
+  for(auto i=0; i<256; ++i) {
+
+    const size_t num_data = random<size_t>(0, 1000);
+
+    std::vector<double> o_doubles(num_data);
+    std::vector<int32_t> o_ints(num_data);
+    for(auto& v : o_doubles) v = random<double>();
+    for(auto& v : o_ints) v = random<int32_t>();
+    auto o_str = random<std::string>();
+
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(o_doubles, o_ints, o_str);
+    
+    // copy into storage aligned for doubles
+    auto bytes = os.str();
+    std::vector<uint64_t> storage(bytes.size() / 8 + 1);
+    std::memcpy(storage.data(), bytes.data(), bytes.size());
+    auto data = reinterpret_cast<const char*>(storage.data());
+
+    ciri::InputBuffer buffer(data, bytes.size());
+    ciri::Deserializer iar(buffer);
+
+    ciri::Span<const double> i_doubles;
+    ciri::Span<const int32_t> i_ints;
+    std::string_view i_str;
+    auto isz = iar(i_doubles, i_ints, i_str);
+
+    REQUIRE(buffer.remaining() == 0);
+    REQUIRE(osz == isz);
+    REQUIRE(i_doubles.size() == num_data);
+    REQUIRE(i_ints.size() == num_data);
+    REQUIRE(std::equal(o_doubles.begin(), o_doubles.end(), i_doubles.begin()));
+    REQUIRE(std::equal(o_ints.begin(), o_ints.end(), i_ints.begin()));
+    REQUIRE(i_str == o_str);
+
+    // views point into the input
+    REQUIRE(reinterpret_cast<const char*>(i_doubles.data()) == data + sizeof(size_t));
+    REQUIRE(i_str.data() + i_str.size() == data + bytes.size());
+  }
+
+  // a view that is not aligned for its element type throws
+  std::ostringstream os;
+  ciri::Serializer oar(os);
+  oar(std::string("abc"), std::vector<double>{1.0, 2.0});
+
+  auto bytes = os.str();
+  std::vector<uint64_t> storage(bytes.size() / 8 + 1);
+  std::memcpy(storage.data(), bytes.data(), bytes.size());
+
+  ciri::InputBuffer buffer(reinterpret_cast<const char*>(storage.data()), bytes.size());
+  ciri::Deserializer iar(buffer);
+  std::string_view i_str;
+  ciri::Span<const double> i_doubles;
+  REQUIRE_THROWS_AS(iar(i_str, i_doubles), std::system_error);
+}
+
+// Procedure: test_save_views
+void test_save_views() {
+
+  for(auto i=0; i<256; ++i) {
+
+    const size_t num_data = random<size_t>(0, 1000);
+
+    std::vector<int32_t> o_ints(num_data);
+    for(auto& v : o_ints) v = random<int32_t>();
+    auto o_str = random<std::string>();
+
+    int16_t o_carr[17];
+    std::string o_strs[3];
+    std::optional<double> o_opts[5];
+    char o_chars[4][2];
+    for(auto& v : o_carr) v = random<int16_t>();
+    for(auto& v : o_strs) v = random<std::string>();
+    for(auto& v : o_opts) if(random<int>(0, 1)) v = random<double>();
+    for(auto& row : o_chars) for(auto& c : row) c = random<char>();
+
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(
+      std::string_view(o_str), 
+      ciri::Span<const int32_t>(o_ints),
+      o_carr,
+      o_strs,
+      o_opts,
+      o_chars
+    );
+
+    // read back into owning containers
+    std::string i_str;
+    std::vector<int32_t> i_ints;
+    std::vector<int16_t> i_carr;
+    std::vector<std::string> i_strs;
+    std::vector<std::optional<double>> i_opts;
+    std::vector<std::string> i_chars;
+    std::istringstream is(os.str());
+    ciri::Deserializer iar(is);
+    auto isz = iar(i_str, i_ints, i_carr, i_strs, i_opts, i_chars);
+
+    REQUIRE(0 == is.rdbuf()->in_avail());
+    REQUIRE(osz == isz);
+    REQUIRE(i_str == o_str);
+    REQUIRE(i_ints == o_ints);
+    REQUIRE(std::equal(std::begin(o_carr), std::end(o_carr), i_carr.begin(), i_carr.end()));
+    REQUIRE(std::equal(std::begin(o_strs), std::end(o_strs), i_strs.begin(), i_strs.end()));
+    REQUIRE(std::equal(std::begin(o_opts), std::end(o_opts), i_opts.begin(), i_opts.end()));
+    REQUIRE(i_chars.size() == 4);
+    for(size_t r=0; r<4; ++r) {
+      REQUIRE(i_chars[r] == std::string(o_chars[r], 2));
+    }
+
+    // and back into C arrays
+    int16_t i_carr2[17];
+    std::string i_strs2[3];
+    std::optional<double> i_opts2[5];
+    char i_chars2[4][2];
+    std::istringstream is2(os.str());
+    ciri::Deserializer iar2(is2);
+    REQUIRE(iar2(i_str, i_ints, i_carr2, i_strs2, i_opts2, i_chars2) == osz);
+    REQUIRE(std::equal(std::begin(o_carr), std::end(o_carr), std::begin(i_carr2)));
+    REQUIRE(std::equal(std::begin(o_strs), std::end(o_strs), std::begin(i_strs2)));
+    REQUIRE(std::equal(std::begin(o_opts), std::end(o_opts), std::begin(i_opts2)));
+    REQUIRE(std::memcmp(o_chars, i_chars2, sizeof(o_chars)) == 0);
+  }
+
+  // C strings are written like std::basic_string without the terminator, 
+  // while character arrays are written whole
+  {
+    const char* o_lit = "abc";
+    const wchar_t* o_wlit = L"xyz";
+    char o_name[16] = "ciri";
+    o_name[8] = 'x';
+    std::ostringstream los, sos;
+    ciri::Serializer loar(los), soar(sos);
+    REQUIRE(loar(o_lit, o_wlit) == soar(std::string("abc"), std::wstring(L"xyz")));
+    REQUIRE(los.str() == sos.str());
+    REQUIRE(loar(o_name, std::string("ciri")) == sizeof(o_name) + 4 + 2*sizeof(std::streamsize));
+
+    std::string i_lit;
+    std::wstring i_wlit;
+    char i_name[16];
+    char i_padded[8];
+    std::fill(std::begin(i_padded), std::end(i_padded), 'x');
+    std::istringstream is(los.str());
+    ciri::Deserializer iar(is);
+    iar(i_lit, i_wlit, i_name, i_padded);
+    REQUIRE(0 == is.rdbuf()->in_avail());
+    REQUIRE(i_lit == "abc");
+    REQUIRE(i_wlit.compare(L"xyz") == 0);
+    REQUIRE(std::memcmp(i_name, o_name, sizeof(o_name)) == 0);
+    REQUIRE(std::string(i_padded) == "ciri");
+    REQUIRE(std::all_of(i_padded + 4, i_padded + 8, [](char c){ return c == '\0'; }));
+
+    // a string longer than the character array throws
+    char i_short[2];
+    std::istringstream sis(sos.str());
+    ciri::Deserializer siar(sis);
+    REQUIRE_THROWS_AS(siar(i_short), std::system_error);
+    
+    // a null C string throws
+    const char* o_null = nullptr;
+    REQUIRE_THROWS_AS(soar(o_null), std::system_error);
+  }
+
+  // loading into a C array of another extent throws
+  std::ostringstream os;
+  ciri::Serializer oar(os);
+  oar(std::vector<int>{1, 2, 3});
+  int i_arr[4];
+  std::istringstream is(os.str());
+  ciri::Deserializer iar(is);
+  REQUIRE_THROWS_AS(iar(i_arr), std::system_error);
+}
+
+// Allocation counter for test_into and test_reuse
+std::atomic<size_t> num_allocations {0};
+
+void* operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if(void* ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+// GCC flags free on memory from operator new once the replacements inline
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Procedure: test_into
+void test_into() {
+
+  std::array<double, 1000> doubles;
+  char chars[256];
+  std::vector<int32_t> ints(500);
+
+  for(auto i=0; i<256; ++i) {
+
+    std::vector<double> o_doubles(random<size_t>(0, doubles.size()));
+    std::vector<int32_t> o_ints(random<size_t>(0, ints.size()));
+    for(auto& v : o_doubles) v = random<double>();
+    for(auto& v : o_ints) v = random<int32_t>();
+    auto o_str = random<std::string>(' ', '~', random<size_t>(0, sizeof(chars)));
+
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(o_doubles, o_str, o_ints);
+
+    size_t num_doubles, num_chars, num_ints;
+    std::istringstream is(os.str());
+    ciri::Deserializer iar(is);
+    auto isz = iar(
+      ciri::make_into(doubles, num_doubles), 
+      ciri::make_into(chars, num_chars),
+      ciri::make_into(ints.data(), ints.size(), num_ints)
+    );
+
+    REQUIRE(0 == is.rdbuf()->in_avail());
+    REQUIRE(osz == isz);
+    REQUIRE(std::vector<double>(doubles.begin(), doubles.begin() + num_doubles) == o_doubles);
+    REQUIRE(std::string(chars, num_chars) == o_str);
+    REQUIRE(std::vector<int32_t>(ints.begin(), ints.begin() + num_ints) == o_ints);
+
+    // saving writes the filled prefix
+    std::ostringstream os2;
+    ciri::Serializer oar2(os2);
+    REQUIRE(oar2(
+      ciri::make_into(doubles, num_doubles), 
+      ciri::make_into(chars, num_chars),
+      ciri::make_into(ints.data(), ints.size(), num_ints)
+    ) == osz);
+    REQUIRE(os2.str() == os.str());
+  }
+
+  // an encoded length beyond the capacity is reported, and the excess is 
+  // skipped so the next item still loads
+  {
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    const auto o_long = random<std::string>(' ', '~', sizeof(chars) + 300);
+    oar(o_long, std::vector<int32_t>{1, 2, 3});
+
+    for(bool viewed : {false, true}) {
+      auto bytes = os.str();
+      std::istringstream is(bytes);
+      ciri::InputBuffer buffer(bytes.data(), bytes.size());
+      size_t num_chars = 0, num_ints = 0;
+      auto into = ciri::make_into(chars, num_chars);
+      if(viewed) {
+        ciri::Deserializer iar(buffer);
+        auto before = num_allocations.load();
+        iar(into, ciri::make_into(ints.data(), ints.size(), num_ints));
+        REQUIRE(before == num_allocations.load());
+        REQUIRE(buffer.remaining() == 0);
+      }
+      else {
+        ciri::Deserializer iar(is);
+        iar(into, ciri::make_into(ints.data(), ints.size(), num_ints));
+        REQUIRE(0 == is.rdbuf()->in_avail());
+      }
+      REQUIRE(into.truncated());
+      REQUIRE(num_chars == o_long.size());
+      REQUIRE(std::string(chars, sizeof(chars)) == o_long.substr(0, sizeof(chars)));
+      REQUIRE(num_ints == 3);
+      REQUIRE(ints[2] == 3);
+
+      // a truncated load cannot be saved back
+      std::ostringstream os2;
+      ciri::Serializer oar2(os2);
+      REQUIRE_THROWS_AS(oar2(into), std::system_error);
+    }
+  }
+}
+
+// Procedure: test_default_init
+void test_default_init() {
+
+  using FloatVector = std::vector<float, ciri::DefaultInitAllocator<float>>;
+
+  for(auto i=0; i<64; ++i) {
+
+    // cover both in-place and chunked growth
+    const size_t num_data = random<size_t>(0, 100000);
+
+    std::vector<float> o_floats(num_data);
+    for(auto& v : o_floats) v = random<float>();
+    auto o_str = random<std::string>(' ', '~', random<size_t>(0, 100000));
+
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(o_str, o_floats, o_floats);
+
+    // streams and memory buffers, misaligned for floats when the string 
+    // length is not a multiple of four
+    FloatVector i_floats1;
+    std::vector<float> i_floats2(random<size_t>(0, 100000), 1.0f);
+    std::string i_str;
+    std::istringstream is(os.str());
+    ciri::Deserializer iar(is);
+    REQUIRE(iar(i_str, i_floats1, i_floats2) == osz);
+    REQUIRE(0 == is.rdbuf()->in_avail());
+    REQUIRE(i_str == o_str);
+    REQUIRE(std::equal(i_floats1.begin(), i_floats1.end(), o_floats.begin(), o_floats.end()));
+    REQUIRE(i_floats2 == o_floats);
+
+    auto bytes = os.str();
+    ciri::InputBuffer buffer(bytes.data(), bytes.size());
+    ciri::Deserializer bar(buffer);
+    std::string b_str;
+    FloatVector b_floats1;
+    std::vector<float> b_floats2;
+    REQUIRE(bar(b_str, b_floats1, b_floats2) == osz);
+    REQUIRE(buffer.remaining() == 0);
+    REQUIRE(b_str == o_str);
+    REQUIRE(std::equal(b_floats1.begin(), b_floats1.end(), o_floats.begin(), o_floats.end()));
+    REQUIRE(b_floats2 == o_floats);
+  }
+
+  // a truncated input still throws
+  std::ostringstream os;
+  ciri::Serializer oar(os);
+  oar(std::vector<double>(100000, 1.0));
+  auto bytes = os.str();
+  bytes.resize(bytes.size() / 2);
+  ciri::InputBuffer buffer(bytes.data(), bytes.size());
+  ciri::Deserializer iar(buffer);
+  std::vector<double> i_doubles;
+  REQUIRE_THROWS_AS(iar(i_doubles), std::system_error);
+}
+
+// Class: CountingResource
+// Memory resource that counts the allocations it forwards upstream.
+class CountingResource : public std::pmr::memory_resource {
+
+  public:
+
+    size_t num_allocations() const { return _num_allocations; }
+
+  private:
+
+    std::pmr::memory_resource* _upstream {std::pmr::new_delete_resource()};
+
+    size_t _num_allocations {0};
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+      ++_num_allocations;
+      return _upstream->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+      _upstream->deallocate(ptr, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& rhs) const noexcept override {
+      return this == &rhs;
+    }
+};
+
+// Procedure: test_reuse
+void test_reuse() {
+
+  // containers with the standard allocator, counted by the global new
+  for(auto i=0; i<32; ++i) {
+
+    const size_t num_data = random<size_t>(0, 200);
+
+    std::map<std::string, std::vector<int>> o_map;
+    std::unordered_map<int, std::string> o_umap;
+    std::set<std::string> o_set;
+    std::unordered_set<std::string> o_uset;
+    std::list<std::string> o_list;
+    std::deque<std::vector<double>> o_deque;
+    std::map<int, std::map<int, std::string>> o_nested;
+
+    for(size_t j=0; j<num_data; ++j) {
+      auto str = random<std::string>(' ', '~', random<size_t>(20, 60));
+      o_map[str] = std::vector<int>(random<size_t>(0, 100), random<int>());
+      o_umap[random<int>()] = str;
+      o_set.insert(str);
+      o_uset.insert(str);
+      o_list.push_back(str);
+      o_deque.emplace_back(random<size_t>(0, 100), random<double>());
+      o_nested[random<int>(0, 20)][random<int>()] = str;
+    }
+
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(o_map, o_umap, o_set, o_uset, o_list, o_deque, o_nested);
+    auto bytes = os.str();
+
+    std::map<std::string, std::vector<int>> i_map;
+    std::unordered_map<int, std::string> i_umap;
+    std::set<std::string> i_set;
+    std::unordered_set<std::string> i_uset;
+    std::list<std::string> i_list;
+    std::deque<std::vector<double>> i_deque;
+    std::map<int, std::map<int, std::string>> i_nested;
+
+    // stale contents of another shape are replaced
+    i_map["stale"] = {1, 2, 3};
+    i_set.insert("stale");
+
+    // two warm-up loads fill the containers and the node pools
+    for(int k=0; k<3; ++k) {
+
+      ciri::InputBuffer buffer(bytes.data(), bytes.size());
+      ciri::Deserializer iar(buffer);
+      iar.reuse(true);
+
+      auto before = num_allocations.load();
+      auto isz = iar(i_map, i_umap, i_set, i_uset, i_list, i_deque, i_nested);
+      auto after = num_allocations.load();
+
+      REQUIRE(osz == isz);
+      REQUIRE(buffer.remaining() == 0);
+      REQUIRE(o_map == i_map);
+      REQUIRE(o_umap == i_umap);
+      REQUIRE(o_set == i_set);
+      REQUIRE(o_uset == i_uset);
+      REQUIRE(o_list == i_list);
+      REQUIRE(o_deque == i_deque);
+      REQUIRE(o_nested == i_nested);
+
+      if(k == 2) {
+        REQUIRE(before == after);
+      }
+    }
+  }
+
+  // std::pmr containers, counted by their memory resource
+  for(auto i=0; i<32; ++i) {
+
+    const size_t num_data = random<size_t>(0, 200);
+
+    std::pmr::map<std::pmr::string, std::pmr::vector<int>> o_map;
+    std::pmr::unordered_map<int, std::pmr::string> o_umap;
+    std::pmr::set<std::pmr::string> o_set;
+    std::pmr::unordered_set<std::pmr::string> o_uset;
+    std::pmr::list<std::pmr::string> o_list;
+    std::pmr::deque<std::pmr::vector<double>> o_deque;
+    std::pmr::map<int, std::pmr::map<int, std::pmr::string>> o_nested;
+
+    for(size_t j=0; j<num_data; ++j) {
+      auto str = random<std::string>(' ', '~', random<size_t>(20, 60));
+      std::pmr::string pstr(str.data(), str.size());
+      o_map[pstr] = std::pmr::vector<int>(random<size_t>(0, 100), random<int>());
+      o_umap[random<int>()] = pstr;
+      o_set.insert(pstr);
+      o_uset.insert(pstr);
+      o_list.push_back(pstr);
+      o_deque.emplace_back(random<size_t>(0, 100), random<double>());
+      o_nested[random<int>(0, 20)][random<int>()] = pstr;
+    }
+
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(o_map, o_umap, o_set, o_uset, o_list, o_deque, o_nested);
+    auto bytes = os.str();
+
+    // every allocation of the loaded containers goes through the counter
+    CountingResource counter;
+
+    std::pmr::map<std::pmr::string, std::pmr::vector<int>> i_map(&counter);
+    std::pmr::unordered_map<int, std::pmr::string> i_umap(&counter);
+    std::pmr::set<std::pmr::string> i_set(&counter);
+    std::pmr::unordered_set<std::pmr::string> i_uset(&counter);
+    std::pmr::list<std::pmr::string> i_list(&counter);
+    std::pmr::deque<std::pmr::vector<double>> i_deque(&counter);
+    std::pmr::map<int, std::pmr::map<int, std::pmr::string>> i_nested(&counter);
+
+    // stale contents of another shape are replaced
+    i_map["stale"] = {1, 2, 3};
+    i_set.insert("stale");
+
+    // two warm-up loads fill the containers and the node pools
+    for(int k=0; k<3; ++k) {
+
+      ciri::InputBuffer buffer(bytes.data(), bytes.size());
+      ciri::Deserializer iar(buffer);
+      iar.reuse(true);
+
+      // temporaries built with the default resource are counted as well
+      auto prev = std::pmr::set_default_resource(&counter);
+      auto before = counter.num_allocations();
+      auto isz = iar(i_map, i_umap, i_set, i_uset, i_list, i_deque, i_nested);
+      auto after = counter.num_allocations();
+      std::pmr::set_default_resource(prev);
+
+      REQUIRE(osz == isz);
+      REQUIRE(buffer.remaining() == 0);
+      REQUIRE(o_map == i_map);
+      REQUIRE(o_umap == i_umap);
+      REQUIRE(o_set == i_set);
+      REQUIRE(o_uset == i_uset);
+      REQUIRE(o_list == i_list);
+      REQUIRE(o_deque == i_deque);
+      REQUIRE(o_nested == i_nested);
+
+      if(k == 2) {
+        REQUIRE(before == after);
+      }
+    }
+  }
+}
+
+// Procedure: test_pmr
+// Allocator-aware type that records the resource it was constructed with
+struct ArenaRecord {
+
+  using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+  std::pmr::string name;
+  std::pmr::vector<int> values;
+
+  ArenaRecord() = default;
+  ArenaRecord(std::allocator_arg_t, const allocator_type& alloc) : name(alloc), values(alloc) {}
+  ArenaRecord(ArenaRecord&& rhs, const allocator_type& alloc) : 
+    name(std::move(rhs.name), alloc), values(std::move(rhs.values), alloc) {}
+  ArenaRecord(ArenaRecord&&) = default;
+  
+  template <typename ArchiverT>
+  auto save(ArchiverT& ar) const { return ar(name, values); }
+
+  template <typename ArchiverT>
+  auto load(ArchiverT& ar) { return ar(name, values); }
+};
+
+void test_pmr() {
+
+  for(auto i=0; i<32; ++i) {
+
+    const size_t num_data = random<size_t>(0, 100);
+
+    // long strings so that nothing fits the small-string buffer
+    auto long_string = [](){ return random<std::string>(' ', '~', random<size_t>(32, 64)); };
+
+    std::map<std::string, std::vector<int>> o_map;
+    std::unordered_map<int, std::string> o_umap;
+    std::set<std::string> o_set;
+    std::list<std::string> o_list;
+    std::map<int, std::tuple<std::string, std::vector<int>>> o_records;
+    std::optional<std::string> o_opt = long_string();
+    std::variant<int, std::string> o_var = long_string();
+
+    for(size_t j=0; j<num_data; ++j) {
+      o_map[long_string()] = std::vector<int>(random<size_t>(1, 50), random<int>());
+      o_umap[random<int>()] = long_string();
+      o_set.insert(long_string());
+      o_list.push_back(long_string());
+      o_records[random<int>()] = std::make_tuple(long_string(), std::vector<int>(random<size_t>(1, 50)));
+    }
+
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(o_map, o_umap, o_set, o_list, o_records, o_opt, o_var);
+    auto bytes = os.str();
+
+    // any allocation that bypasses the arena fails
+    std::pmr::monotonic_buffer_resource arena;
+    auto prev = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+
+    std::pmr::map<std::pmr::string, std::pmr::vector<int>> i_map(&arena);
+    std::pmr::unordered_map<int, std::pmr::string> i_umap(&arena);
+    std::pmr::set<std::pmr::string> i_set(&arena);
+    std::pmr::list<std::pmr::string> i_list(&arena);
+    std::pmr::map<int, ArenaRecord> i_records(&arena);
+    std::optional<std::pmr::string> i_opt;
+    std::variant<int, std::pmr::string> i_var;
+
+    ciri::InputBuffer buffer(bytes.data(), bytes.size());
+    ciri::Deserializer iar(buffer, &arena);
+    auto isz = iar(i_map, i_umap, i_set, i_list, i_records, i_opt, i_var);
+
+    std::pmr::set_default_resource(prev);
+
+    REQUIRE(osz == isz);
+    REQUIRE(buffer.remaining() == 0);
+    
+    REQUIRE(i_map.size() == o_map.size());
+    for(auto& [k, v] : i_map) {
+      REQUIRE(v == std::pmr::vector<int>(o_map.at(std::string(k)).begin(), o_map.at(std::string(k)).end()));
+      REQUIRE(k.get_allocator().resource() == &arena);
+      REQUIRE(v.get_allocator().resource() == &arena);
+    }
+    
+    REQUIRE(i_umap.size() == o_umap.size());
+    for(auto& [k, v] : i_umap) {
+      REQUIRE(std::string(v) == o_umap.at(k));
+      REQUIRE(v.get_allocator().resource() == &arena);
+    }
+
+    REQUIRE(std::equal(i_set.begin(), i_set.end(), o_set.begin(), o_set.end(), 
+      [](auto& a, auto& b){ return std::string(a) == b; }
+    ));
+    REQUIRE(std::equal(i_list.begin(), i_list.end(), o_list.begin(), o_list.end(), 
+      [](auto& a, auto& b){ return std::string(a) == b; }
+    ));
+
+    REQUIRE(i_records.size() == o_records.size());
+    for(auto& [k, r] : i_records) {
+      REQUIRE(std::string(r.name) == std::get<0>(o_records.at(k)));
+      REQUIRE(r.name.get_allocator().resource() == &arena);
+      REQUIRE(r.values.get_allocator().resource() == &arena);
+    }
+
+    REQUIRE(std::string(*i_opt) == *o_opt);
+    REQUIRE(i_opt->get_allocator().resource() == &arena);
+    REQUIRE(std::string(std::get<1>(i_var)) == std::get<1>(o_var));
+    REQUIRE(std::get<1>(i_var).get_allocator().resource() == &arena);
+  }
+}
+
+// Procedure: test_parallel_save
+void test_parallel_save() {
+
+  using Array = std::array<std::string, 3*ciri::PARALLEL_CHUNK_SIZE + 5>;
+
+  for(auto i=0; i<8; ++i) {
+
+    const size_t num_data = random<size_t>(0, 4*ciri::PARALLEL_CHUNK_SIZE);
+
+    std::vector<std::string> o_strs(num_data);
+    std::deque<std::vector<int>> o_vecs(num_data);
+    auto o_arr = std::make_unique<Array>();
+    for(auto& v : o_strs) v = random<std::string>(' ', '~', random<size_t>(0, 20));
+    for(auto& v : o_vecs) v.resize(random<size_t>(0, 4), random<int>());
+    for(auto& v : *o_arr) v = random<std::string>(' ', '~', random<size_t>(0, 8));
+
+    // the bytes do not depend on the number of threads
+    std::string bytes;
+    std::streamsize osz = 0;
+    for(size_t num_threads : {1, 2, 7}) {
+      std::ostringstream os;
+      ciri::ThreadPool pool(num_threads);
+      ciri::Serializer oar(os);
+      oar.parallel(&pool);
+      auto sz = oar(o_strs, o_vecs, *o_arr);
+      if(num_threads == 1) {
+        bytes = os.str();
+        osz = sz;
+      }
+      REQUIRE(sz == osz);
+      REQUIRE(os.str() == bytes);
+    }
+    REQUIRE(bytes.size() == static_cast<size_t>(osz));
+    
+    // small containers and arrays keep the sequential layout
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto ssz = oar(o_strs, o_vecs);
+    if(num_data <= ciri::PARALLEL_CHUNK_SIZE) {
+      REQUIRE(os.str() == bytes.substr(0, ssz));
+    }
+    else {
+      REQUIRE(os.str() != bytes.substr(0, ssz));
+    }
+    std::ostringstream os_arr;
+    ciri::Serializer oar_arr(os_arr);
+    auto asz = oar_arr(*o_arr);
+    REQUIRE(os_arr.str() == bytes.substr(bytes.size() - asz));
+
+    std::vector<std::string> i_strs;
+    std::deque<std::vector<int>> i_vecs;
+    auto i_arr = std::make_unique<Array>();
+    std::istringstream is(bytes);
+    ciri::Deserializer iar(is);
+    auto isz = iar(i_strs, i_vecs, *i_arr);
+
+    REQUIRE(0 == is.rdbuf()->in_avail());
+    REQUIRE(osz == isz);
+    REQUIRE(o_strs == i_strs);
+    REQUIRE(o_vecs == i_vecs);
+    REQUIRE(*o_arr == *i_arr);
+  }
+
+  // a chunk whose byte count does not match its contents throws
+  std::vector<std::string> o_strs(2*ciri::PARALLEL_CHUNK_SIZE, "ciri");
+  std::ostringstream os;
+  ciri::ThreadPool pool(2);
+  ciri::Serializer oar(os);
+  oar.parallel(&pool);
+  oar(o_strs);
+  auto bytes = os.str();
+  bytes[2*sizeof(size_t)] ^= 1;
+  std::vector<std::string> i_strs;
+  std::istringstream is(bytes);
+  ciri::Deserializer iar(is);
+  REQUIRE_THROWS_AS(iar(i_strs), std::system_error);
+}
+
+// Procedure: test_parallel_load
+void test_parallel_load() {
+
+  ciri::ThreadPool pool2(2), pool4(4);
+
+  for(auto i=0; i<8; ++i) {
+
+    const size_t num_data = random<size_t>(0, 4*ciri::PARALLEL_CHUNK_SIZE);
+
+    std::vector<std::string> o_strs(num_data);
+    std::deque<std::vector<int>> o_vecs(num_data);
+    std::vector<std::vector<std::string>> o_nested(random<size_t>(0, 3));
+    for(auto& v : o_strs) v = random<std::string>(' ', '~', random<size_t>(0, 20));
+    for(auto& v : o_vecs) v.resize(random<size_t>(0, 4), random<int>());
+    for(auto& v : o_nested) v.resize(random<size_t>(0, 2*ciri::PARALLEL_CHUNK_SIZE), "nested");
+
+    for(bool chunked : {true, false}) {
+
+      std::ostringstream os;
+      ciri::Serializer oar(os);
+      oar.parallel(chunked ? &pool2 : nullptr);
+      auto osz = oar(o_strs, o_vecs, o_nested);
+      auto bytes = os.str();
+
+      // memory input decodes chunks in parallel, streams sequentially
+      ciri::ThreadPool pool1(1);
+      for(ciri::ThreadPool* pool : {static_cast<ciri::ThreadPool*>(nullptr), &pool1, &pool4}) {
+
+        std::vector<std::string> i_strs(random<size_t>(0, 10), "stale");
+        std::deque<std::vector<int>> i_vecs;
+        std::vector<std::vector<std::string>> i_nested;
+
+        ciri::InputBuffer buffer(bytes.data(), bytes.size());
+        ciri::Deserializer iar(buffer);
+        iar.parallel(pool);
+        REQUIRE(iar(i_strs, i_vecs, i_nested) == osz);
+        REQUIRE(buffer.remaining() == 0);
+        REQUIRE(o_strs == i_strs);
+        REQUIRE(o_vecs == i_vecs);
+        REQUIRE(o_nested == i_nested);
+
+        std::istringstream is(bytes);
+        ciri::Deserializer sar(is);
+        sar.parallel(pool);
+        REQUIRE(sar(i_strs, i_vecs, i_nested) == osz);
+        REQUIRE(0 == is.rdbuf()->in_avail());
+        REQUIRE(o_strs == i_strs);
+        REQUIRE(o_vecs == i_vecs);
+        REQUIRE(o_nested == i_nested);
+      }
+    }
+  }
+
+  // chunk decoders allocate temporaries from the parent's resource
+  {
+    std::vector<std::variant<int, std::string>> o_vars(4*ciri::PARALLEL_CHUNK_SIZE);
+    for(auto& v : o_vars) v = random<std::string>(' ', '~', random<size_t>(32, 64));
+
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    oar.parallel(&pool2);
+    auto osz = oar(o_vars);
+    auto bytes = os.str();
+
+    std::pmr::synchronized_pool_resource arena;
+    auto prev = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+
+    std::vector<std::variant<int, std::pmr::string>> i_vars;
+    ciri::InputBuffer buffer(bytes.data(), bytes.size());
+    ciri::Deserializer iar(buffer, &arena);
+    iar.parallel(&pool4);
+    auto isz = iar(i_vars);
+
+    std::pmr::set_default_resource(prev);
+
+    REQUIRE(isz == osz);
+    REQUIRE(i_vars.size() == o_vars.size());
+    for(size_t j=0; j<o_vars.size(); ++j) {
+      REQUIRE(std::get<1>(i_vars[j]) == std::get<1>(o_vars[j]).c_str());
+      REQUIRE(std::get<1>(i_vars[j]).get_allocator().resource() == &arena);
+    }
+  }
+
+  // corruption inside a chunk surfaces from the decoding thread
+  std::vector<std::string> o_strs(4*ciri::PARALLEL_CHUNK_SIZE, "ciri");
+  std::ostringstream os;
+  ciri::Serializer oar(os);
+  oar.parallel(&pool2);
+  oar(o_strs);
+  auto bytes = os.str();
+  // shorten the last string of the third chunk so it ends a byte early
+  size_t offset = 2*sizeof(size_t);
+  uint64_t num_bytes;
+  for(int c=0; c<3; ++c) {
+    std::memcpy(&num_bytes, bytes.data() + offset, sizeof(num_bytes));
+    offset += sizeof(num_bytes) + num_bytes;
+  }
+  bytes[offset - sizeof(size_t) - 4] -= 1;
+
+  std::vector<std::string> i_strs;
+  ciri::InputBuffer buffer(bytes.data(), bytes.size());
+  ciri::Deserializer iar(buffer);
+  iar.parallel(&pool4);
+  REQUIRE_THROWS_AS(iar(i_strs), std::system_error);
+}
+
+// Procedure: test_partitioned
+void test_partitioned() {
+
+  using Map = std::unordered_map<uint64_t, std::string>;
+  using Set = std::unordered_set<std::string>;
+
+  for(auto i=0; i<4; ++i) {
+
+    const size_t num_data = random<size_t>(0, 4*ciri::PARALLEL_CHUNK_SIZE);
+
+    Map o_map;
+    Set o_set;
+    for(size_t j=0; j<num_data; ++j) {
+      o_map[random<uint64_t>()] = random<std::string>(' ', '~', random<size_t>(0, 20));
+      o_set.insert(random<std::string>(' ', '~', 12));
+    }
+
+    // plain and partitioned layouts; the latter does not depend on threads
+    std::ostringstream os_plain;
+    ciri::Serializer par(os_plain);
+    par(o_map, o_set);
+
+    std::string bytes;
+    for(size_t num_threads : {1, 3}) {
+      std::ostringstream os;
+      ciri::ThreadPool pool(num_threads);
+      ciri::Serializer oar(os);
+      oar.parallel(&pool);
+      oar(o_map, o_set);
+      if(num_threads == 1) {
+        bytes = os.str();
+      }
+      REQUIRE(os.str() == bytes);
+    }
+    
+    // a sharded container saves the same items
+    std::vector<Map> o_map_shards(5);
+    for(auto& [k, v] : o_map) {
+      o_map_shards[ciri::shard_index(o_map_shards, k)][k] = v;
+    }
+    std::ostringstream os_shards;
+    ciri::ThreadPool pool(2);
+    ciri::Serializer sar(os_shards);
+    sar.parallel(&pool);
+    sar(ciri::make_sharded(o_map_shards));
+
+    for(auto& archive : {os_plain.str(), bytes}) {
+      ciri::ThreadPool pool4(4);
+      for(ciri::ThreadPool* pool : {static_cast<ciri::ThreadPool*>(nullptr), &pool4}) {
+        
+        // a single container
+        Map i_map {{1, "stale"}};
+        Set i_set;
+        ciri::InputBuffer buffer(archive.data(), archive.size());
+        ciri::Deserializer iar(buffer);
+        iar.parallel(pool);
+        REQUIRE(iar(i_map, i_set) == static_cast<std::streamsize>(archive.size()));
+        REQUIRE(i_map == o_map);
+        REQUIRE(i_set == o_set);
+
+        // shards
+        for(size_t num_shards : {1, 3, 8}) {
+          std::vector<Map> map_shards(num_shards);
+          std::vector<Set> set_shards(num_shards);
+          ciri::InputBuffer buffer(archive.data(), archive.size());
+          ciri::Deserializer iar(buffer);
+          iar.parallel(pool);
+          iar(ciri::make_sharded(map_shards), ciri::make_sharded(set_shards));
+          REQUIRE(buffer.remaining() == 0);
+          size_t map_size = 0, set_size = 0;
+          for(size_t s=0; s<num_shards; ++s) {
+            for(auto& [k, v] : map_shards[s]) {
+              REQUIRE(ciri::shard_index(map_shards, k) == s);
+              REQUIRE(o_map.at(k) == v);
+            }
+            for(auto& k : set_shards[s]) {
+              REQUIRE(ciri::shard_index(set_shards, k) == s);
+              REQUIRE(o_set.count(k) == 1);
+            }
+            map_size += map_shards[s].size();
+            set_size += set_shards[s].size();
+          }
+          REQUIRE(map_size == o_map.size());
+          REQUIRE(set_size == o_set.size());
+        }
+      }
+    }
+
+    // and a sharded archive loads into one map from a stream
+    Map i_map;
+    std::istringstream is(os_shards.str());
+    ciri::Deserializer iar(is);
+    iar(i_map);
+    REQUIRE(0 == is.rdbuf()->in_avail());
+    REQUIRE(i_map == o_map);
+  }
+}
+
+// Procedure: test_batch
+void test_batch() {
+
+  using Message = std::tuple<int, std::string, std::vector<double>>;
+
+  for(size_t num_workers : {1, 4}) {
+
+    ciri::ThreadPool pool(num_workers);
+    ciri::BatchSerializer batch(pool);
+
+    std::vector<ciri::OutputBuffer> outputs;
+    ciri::OutputBuffer framed;
+
+    // batches reuse the buffers of the previous ones
+    for(auto i=0; i<4; ++i) {
+
+      std::vector<Message> messages(random<size_t>(0, 3000));
+      for(auto& [n, s, v] : messages) {
+        n = random<int>();
+        s = random<std::string>(' ', '~', random<size_t>(0, 40));
+        v.resize(random<size_t>(0, 20));
+        for(auto& d : v) {
+          d = random<double>();
+        }
+      }
+
+      auto osz = batch(messages, outputs);
+      REQUIRE(outputs.size() >= messages.size());
+
+      framed.clear();
+      auto fsz = batch(messages, framed);
+      REQUIRE(fsz == static_cast<std::streamsize>(framed.size()));
+      REQUIRE(fsz == osz + static_cast<std::streamsize>(sizeof(uint64_t) * messages.size()));
+
+      ciri::InputBuffer input(framed.data(), framed.size());
+      ciri::Deserializer iar(input);
+
+      for(size_t j=0; j<messages.size(); ++j) {
+
+        // same bytes as a serializer of its own
+        ciri::OutputBuffer single;
+        ciri::Serializer oar(single);
+        oar(messages[j]);
+        REQUIRE(std::string(outputs[j].data(), outputs[j].size()) == 
+                std::string(single.data(), single.size()));
+
+        uint64_t size;
+        Message message;
+        iar(size);
+        REQUIRE(size == single.size());
+        REQUIRE(iar(message) == static_cast<std::streamsize>(size));
+        REQUIRE(message == messages[j]);
+      }
+      REQUIRE(input.remaining() == 0);
+    }
+  }
+
+  // pool loops with uneven work and errors
+  ciri::ThreadPool pool(3);
+
+  std::vector<std::atomic<int>> hits(10000);
+  std::atomic<size_t> max_worker {0};
+  pool.parallel_for(hits.size(), 1, [&] (size_t i, size_t w) {
+    if(w > max_worker) {
+      max_worker = w;
+    }
+    if(i < 100) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    hits[i]++;
+  });
+  for(auto& h : hits) {
+    REQUIRE(h == 1);
+  }
+  REQUIRE(max_worker < pool.num_workers());
+
+  REQUIRE_THROWS_AS(
+    pool.parallel_for(1000, 8, [] (size_t i, size_t) {
+      if(i == 500) {
+        throw std::runtime_error("batch");
+      }
+    }),
+    std::runtime_error
+  );
+  
+  size_t sum = 0;
+  pool.parallel_for(1, 8, [&] (size_t i, size_t) { sum += i + 1; });
+  REQUIRE(sum == 1);
+}
+
+// Procedure: test_append_log
+void test_append_log() {
+
+  using Record = std::tuple<size_t, size_t, std::string>;
+
+  const size_t num_threads = 4;
+  const size_t num_records = 2000;
+
+  for(size_t capacity : {64, 4096, 1 << 20}) {
+
+    ciri::OutputBuffer output;
+    std::vector<std::vector<Record>> records(num_threads);
+
+    {
+      ciri::AppendLog log(output, capacity);
+      REQUIRE(log.capacity() >= capacity);
+
+      std::vector<std::thread> threads;
+      for(size_t t=0; t<num_threads; ++t) {
+        threads.emplace_back([&, t] () {
+          for(size_t j=0; j<num_records; ++j) {
+            Record record {t, j, random<std::string>(' ', '~', random<size_t>(0, 20))};
+            // slots of 64 bytes fit 16 bytes of header and 48 of record
+            if(j % 2) {
+              log(record);
+            }
+            else {
+              log.bounded(48, record);
+            }
+            records[t].push_back(record);
+          }
+        });
+      }
+      for(auto& thread : threads) {
+        thread.join();
+      }
+
+      // records that do not fit fail alone
+      REQUIRE_THROWS_AS(log.bounded(4, std::string(10, 'a')), std::system_error);
+      REQUIRE_THROWS_AS(log(std::string(capacity, 'a')), std::system_error);
+
+      Record last {num_threads, 0, "last"};
+      log(last);
+      log.flush();
+      records.push_back({last});
+    }
+    
+    // records of each thread come out in the order they were appended
+    ciri::InputBuffer input(output.data(), output.size());
+    ciri::Deserializer iar(input);
+    std::vector<size_t> next(num_threads + 1, 0);
+    while(input.remaining()) {
+      Record record;
+      iar(record);
+      auto t = std::get<0>(record);
+      REQUIRE(t <= num_threads);
+      REQUIRE(record == records[t][next[t]++]);
+    }
+    for(size_t t=0; t<=num_threads; ++t) {
+      REQUIRE(next[t] == records[t].size());
+    }
+  }
+
+  // close writes the remaining records and later appends throw
+  {
+    ciri::OutputBuffer output;
+    ciri::AppendLog log(output);
+    log(std::string("tail"));
+    log.close();
+    REQUIRE(output.size() == sizeof(std::streamsize) + 4);
+    REQUIRE_THROWS_AS(log(std::string("late")), std::system_error);
+    log.close();
+  }
+
+  // an error of the device surfaces from close
+  {
+    struct BrokenOutput {
+      void write(const char*, std::streamsize) { throw std::runtime_error("broken"); }
+    } broken;
+    ciri::AppendLog log(broken);
+    log(std::string("lost"));
+    REQUIRE_THROWS_AS(log.close(), std::runtime_error);
+  }
+}
+
+// Procedure: test_pipeline
+void test_pipeline() {
+
+  using Stages = std::vector<ciri::PipelineStage>;
+
+  std::vector<std::tuple<Stages, Stages, bool>> chains {
+    {{}, {}, false},
+    {{ciri::compress_stage()}, {ciri::decompress_stage()}, false},
+    {{ciri::checksum_stage()}, {ciri::verify_stage()}, true},
+    {{ciri::compress_stage(), ciri::checksum_stage()}, {ciri::verify_stage(), ciri::decompress_stage()}, true}
+  };
+
+  for(auto& [write_stages, read_stages, verified] : chains) {
+    for(size_t block_size : {64, 4096}) {
+
+      std::vector<int> o_ints(random<size_t>(0, 20000));
+      for(auto& i : o_ints) {
+        i = random<int>(0, 100);
+      }
+      auto o_str = random<std::string>(' ', '~', random<size_t>(0, 1000));
+
+      ciri::OutputBuffer output;
+      {
+        ciri::PipelineOutput pipe(output, write_stages, block_size, 2);
+        ciri::Serializer oar(pipe);
+        oar(o_ints);
+        pipe.flush();
+        REQUIRE(output.size() >= o_ints.size() / block_size * 4);
+        oar(o_str);
+        pipe.close();
+        REQUIRE_THROWS_AS(oar(o_str), std::system_error);
+      }
+      
+      // bytes after the stream are left to the caller
+      int tail = 7;
+      output.write(reinterpret_cast<const char*>(&tail), sizeof(tail));
+
+      ciri::InputBuffer input(output.data(), output.size());
+      {
+        std::vector<int> i_ints;
+        std::string i_str;
+        ciri::PipelineInput pipe(input, read_stages, 1 << 26, 2);
+        ciri::Deserializer iar(pipe);
+        iar(i_ints, i_str);
+        REQUIRE(i_ints == o_ints);
+        REQUIRE(i_str == o_str);
+        REQUIRE_THROWS_AS(iar(i_str), std::system_error);
+      }
+      REQUIRE(input.remaining() == sizeof(tail));
+
+      // corrupted checksum blocks are caught by the stage that verifies them
+      if(verified && !o_str.empty()) {
+        std::string bytes(output.data(), output.size());
+        bytes[bytes.size() - sizeof(tail) - 8] ^= 1;
+        ciri::InputBuffer corrupted(bytes.data(), bytes.size());
+        std::vector<int> i_ints;
+        std::string i_str;
+        ciri::PipelineInput pipe(corrupted, read_stages);
+        ciri::Deserializer iar(pipe);
+        REQUIRE_THROWS_AS(iar(i_ints, i_str), std::system_error);
+      }
+    }
+  }
+
+  // blocks dropped by a stage count as completed, so flush returns
+  auto count = std::make_shared<std::atomic<size_t>>(0);
+  Stages drop_odd {
+    [count] (const std::vector<char>& in, std::vector<char>& out) {
+      if(count->fetch_add(1) % 2 == 0) {
+        out = in;
+      }
+    }
+  };
+  ciri::OutputBuffer output;
+  ciri::PipelineOutput pipe(output, drop_odd, 16, 2);
+  std::string bytes(16 * 64, 'c');
+  for(size_t i=0; i<4; ++i) {
+    pipe.write(bytes.data(), bytes.size());
+    pipe.flush();
+    REQUIRE(output.size() == (i + 1) * 32 * (16 + sizeof(uint32_t)));
+  }
+  pipe.close();
+  REQUIRE(output.size() == 128 * (16 + sizeof(uint32_t)) + sizeof(uint32_t));
+
+  // the largest blocks, framed by both stages, pass the default reader
+  const size_t max_block_size = ciri::PipelineOutput<ciri::OutputBuffer>::MAX_BLOCK_SIZE;
+  std::vector<char> o_bytes(max_block_size + 4096);
+  uint32_t state = 2463534242u;
+  for(auto& c : o_bytes) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    c = static_cast<char>(state);
+  }
+  ciri::OutputBuffer large;
+  {
+    ciri::PipelineOutput lpipe(large, Stages{ciri::compress_stage(), ciri::checksum_stage()}, size_t{1} << 30, 1);
+    lpipe.write(o_bytes.data(), o_bytes.size());
+    lpipe.close();
+  }
+  uint32_t size;
+  std::memcpy(&size, large.data(), sizeof(size));
+  REQUIRE(size > max_block_size);
+
+  ciri::InputBuffer input(large.data(), large.size());
+  ciri::PipelineInput lpipe(input, Stages{ciri::verify_stage(), ciri::decompress_stage()}, max_block_size, 1);
+  std::vector<char> i_bytes(o_bytes.size());
+  lpipe.read(i_bytes.data(), i_bytes.size());
+  REQUIRE(i_bytes == o_bytes);
+}
+
+// Procedure: test_parallel_copy
+void test_parallel_copy() {
+
+  const size_t N = ciri::PARALLEL_COPY_SIZE + 4093;
+
+  // copies of any alignment and size
+  std::vector<char> src(N + 64), dst(N + 64);
+  for(auto& c : src) {
+    c = random<char>();
+  }
+  ciri::ThreadPool pool1(1), pool3(3);
+  for(size_t n : {size_t{0}, size_t{1}, size_t{63}, size_t{64}, size_t{1000}, N}) {
+    for(auto pool : {&pool1, &pool3}) {
+      std::fill(dst.begin(), dst.end(), 0);
+      ciri::parallel_memcpy(dst.data() + 5, src.data() + 3, n, *pool);
+      REQUIRE(std::equal(dst.begin() + 5, dst.begin() + 5 + n, src.begin() + 3));
+      REQUIRE(std::all_of(dst.begin() + 5 + n, dst.end(), [] (char c) { return c == 0; }));
+    }
+  }
+
+  // memory devices
+  std::vector<double> o_doubles(N / sizeof(double) + 7);
+  for(auto& d : o_doubles) {
+    d = random<double>();
+  }
+  auto o_str = random<std::string>(' ', '~', N);
+
+  ciri::OutputBuffer plain;
+  ciri::Serializer par(plain);
+  par(o_doubles, o_str);
+
+  ciri::OutputBuffer output;
+  ciri::ThreadPool pool(4);
+  output.parallel(&pool);
+  REQUIRE(output.parallel() == &pool);
+  ciri::Serializer oar(output);
+  oar(o_doubles, o_str);
+  REQUIRE(output.size() == plain.size());
+  REQUIRE(std::memcmp(output.data(), plain.data(), plain.size()) == 0);
+
+  std::vector<double, ciri::DefaultInitAllocator<double>> i_doubles;
+  std::string i_str;
+  ciri::InputBuffer input(output.data(), output.size());
+  input.parallel(&pool);
+  ciri::Deserializer iar(input);
+  REQUIRE(iar(i_doubles, i_str) == static_cast<std::streamsize>(output.size()));
+  REQUIRE(std::equal(i_doubles.begin(), i_doubles.end(), o_doubles.begin(), o_doubles.end()));
+  REQUIRE(i_str == o_str);
+
+  // fresh containers with the standard allocator read on the pool as well
+  std::vector<double> f_doubles;
+  std::vector<char> f_chars;
+  ciri::InputBuffer finput(output.data(), output.size());
+  finput.parallel(&pool);
+  ciri::Deserializer fiar(finput);
+  REQUIRE(fiar(f_doubles, f_chars) == static_cast<std::streamsize>(output.size()));
+  REQUIRE(f_doubles == o_doubles);
+  REQUIRE(std::equal(f_chars.begin(), f_chars.end(), o_str.begin(), o_str.end()));
+}
+
+// Procedure: test_striped
+void test_striped() {
+
+  for(size_t num_shards : {1, 3}) {
+    for(size_t stripe_size : {7, 4096}) {
+
+      std::vector<int64_t> o_ints(random<size_t>(0, 10000));
+      for(auto& i : o_ints) {
+        i = random<int64_t>();
+      }
+      auto o_str = random<std::string>(' ', '~', random<size_t>(0, 100));
+
+      std::vector<ciri::OutputBuffer> shards(num_shards);
+      ciri::OutputBuffer manifest_buffer;
+      {
+        ciri::StripedOutput output(shards, stripe_size, 2);
+        ciri::Serializer oar(output);
+        oar(o_ints);
+        output.flush();
+        oar(o_str);
+        output.close();
+        REQUIRE_THROWS_AS(oar(o_str), std::system_error);
+
+        ciri::Serializer mar(manifest_buffer);
+        mar(output.manifest());
+      }
+      
+      // stripes are dealt round-robin
+      ciri::StripeManifest manifest;
+      ciri::InputBuffer manifest_input(manifest_buffer.data(), manifest_buffer.size());
+      ciri::Deserializer miar(manifest_input);
+      miar(manifest);
+      REQUIRE(manifest.stripe_size == stripe_size);
+      REQUIRE(manifest.num_shards == num_shards);
+      size_t size = 0;
+      for(auto& shard : shards) {
+        REQUIRE(shard.size() + stripe_size >= manifest.size / num_shards);
+        size += shard.size();
+      }
+      REQUIRE(manifest.size == size);
+      
+      std::vector<ciri::InputBuffer> inputs;
+      for(auto& shard : shards) {
+        inputs.emplace_back(shard.data(), shard.size());
+      }
+      {
+        std::vector<int64_t> i_ints;
+        std::string i_str;
+        ciri::StripedInput input(inputs, manifest, 1 << 26, 2);
+        ciri::Deserializer iar(input);
+        REQUIRE(iar(i_ints, i_str) == static_cast<std::streamsize>(size));
+        REQUIRE(i_ints == o_ints);
+        REQUIRE(i_str == o_str);
+        REQUIRE_THROWS_AS(iar(i_str), std::system_error);
+      }
+      for(auto& input : inputs) {
+        REQUIRE(input.remaining() == 0);
+      }
+      
+      // mismatched and truncated shards
+      auto wrong = manifest;
+      wrong.num_shards += 1;
+      REQUIRE_THROWS_AS(ciri::StripedInput(inputs, wrong), std::system_error);
+
+      // stripes above the maximum size are rejected before allocating
+      auto huge = manifest;
+      huge.stripe_size = uint64_t{1} << 40;
+      REQUIRE_THROWS_AS(ciri::StripedInput(inputs, huge), std::system_error);
+      REQUIRE_THROWS_AS(ciri::StripedInput(inputs, manifest, stripe_size - 1), std::system_error);
+
+      if(size > num_shards * stripe_size) {
+        std::vector<ciri::InputBuffer> truncated;
+        for(auto& shard : shards) {
+          truncated.emplace_back(shard.data(), shard.size() - 1);
+        }
+        std::vector<int64_t> i_ints;
+        std::string i_str;
+        ciri::StripedInput input(truncated, manifest);
+        ciri::Deserializer iar(input);
+        REQUIRE_THROWS_AS(iar(i_ints, i_str), std::system_error);
+      }
+    }
+  }
+
+  // larger stripe sizes are clamped to what the default reader accepts
+  std::vector<ciri::OutputBuffer> shards(2);
+  std::string o_str(1 << 20, 's');
+  ciri::StripeManifest manifest;
+  {
+    ciri::StripedOutput output(shards, size_t{1} << 30, 1);
+    output.write(o_str.data(), o_str.size());
+    output.close();
+    manifest = output.manifest();
+  }
+  REQUIRE(manifest.stripe_size == ciri::StripedOutput<ciri::OutputBuffer>::MAX_STRIPE_SIZE);
+
+  std::vector<ciri::InputBuffer> inputs;
+  for(auto& shard : shards) {
+    inputs.emplace_back(shard.data(), shard.size());
+  }
+  ciri::StripedInput input(inputs, manifest);
+  std::string i_str(o_str.size(), ' ');
+  input.read(i_str.data(), i_str.size());
+  REQUIRE(i_str == o_str);
+}
+
+// Struct: IncrementalRecord
+struct IncrementalRecord {
+
+  int id = random<int>();
+  std::string name = random<std::string>(' ', '~', random<size_t>(0, 20));
+  std::vector<int> values = std::vector<int>(random<size_t>(0, 50), random<int>());
+  std::optional<double> score = random<int>(0, 1) ? std::optional<double>(random<double>()) : std::nullopt;
+  std::deque<std::optional<int>> flags = std::deque<std::optional<int>>(random<size_t>(0, 3), 1);
+
+  template <typename ArchiverT>
+  auto save(ArchiverT& ar) const { 
+    return ar(id, name, ciri::make_size_tag(values.size())) + ar(values, score, flags); 
+  }
+};
+
+// Struct: IncrementalFlags
+struct IncrementalFlags {
+
+  uint8_t a = random<uint8_t>(0, 7);
+  uint8_t b = random<uint8_t>(0, 1);
+
+  template <typename ArchiverT>
+  auto save(ArchiverT& ar) const { return ar(ciri::make_bits<3>(a), ciri::make_bits<1>(b)); }
+};
+
+// Struct: IncrementalTable
+struct IncrementalTable {
+
+  std::string name = random<std::string>(' ', '~', random<size_t>(0, 20));
+  std::vector<IncrementalRecord> rows = std::vector<IncrementalRecord>(random<size_t>(0, 100));
+
+  template <typename ArchiverT>
+  auto save(ArchiverT& ar) const { return ar(name, rows); }
+};
+
+// Struct: IncrementalCounted
+struct IncrementalCounted {
+
+  std::vector<int> values = std::vector<int>(random<size_t>(0, 10000), random<int>());
+
+  template <typename ArchiverT>
+  auto save(ArchiverT& ar) const { 
+    uint32_t n = static_cast<uint32_t>(values.size());
+    return ar(n, values); 
+  }
+};
+
+// Procedure: test_incremental
+void test_incremental() {
+
+  std::vector<IncrementalRecord> records(random<size_t>(0, 2000));
+  std::map<int, std::vector<std::string>> index;
+  for(auto i=0; i<100; ++i) {
+    auto& strings = index[random<int>()];
+    strings.resize(random<size_t>(0, 10));
+    for(auto& s : strings) {
+      s = random<std::string>(' ', '~', random<size_t>(0, 10));
+    }
+  }
+  std::vector<double> values(random<size_t>(0, 100000));
+  for(auto& v : values) {
+    v = random<double>();
+  }
+  auto str = random<std::string>(' ', '~', random<size_t>(0, 10000));
+  std::tuple<int, std::list<std::string>, std::array<int, 4>> tuple {1, {"a", "bc"}, {1, 2, 3, 4}};
+  std::array<std::set<int>, 2> sets {std::set<int>{1, 2}, std::set<int>{3}};
+  std::forward_list<std::unordered_set<int>> lists {{1, 2, 3}, {}, {4}};
+  std::vector<IncrementalFlags> flags(10);
+  int array[3] = {1, 2, 3};
+  std::vector<IncrementalTable> tables(random<size_t>(0, 5));
+  IncrementalCounted counted;
+
+  ciri::OutputBuffer expected;
+  ciri::Serializer oar(expected);
+  oar(records, index, values, str, tuple, sets, lists, flags, array, tables, counted);
+
+  // the records and the counted struct, which saves a local, are written 
+  // whole, as are the size tags and map keys before a frame
+  auto whole_size = [] (const auto& item) {
+    ciri::ByteCounter counter;
+    ciri::Serializer oar(counter);
+    oar(item);
+    return counter.size();
+  };
+  size_t max_whole = whole_size(counted);
+  for(const auto& item : records) {
+    max_whole = std::max(max_whole, whole_size(item) + 16);
+  }
+
+  for(size_t max_bytes : {size_t{1}, size_t{100}, size_t{1} << 16, std::numeric_limits<size_t>::max()}) {
+
+    ciri::OutputBuffer output;
+    ciri::IncrementalSerializer iar(output);
+    iar.start(records, index, values, str, tuple, sets, lists, flags, array, tables, counted);
+    REQUIRE(!iar.done());
+    REQUIRE_THROWS_AS(iar.start(records), std::system_error);
+
+    size_t num_steps = 0;
+    size_t max_step = 0;
+    while(!iar.done()) {
+      const size_t before = output.size();
+      iar.step(max_bytes);
+      max_step = std::max(max_step, output.size() - before);
+      ++num_steps;
+    }
+    
+    // steps stop at the budget, save for the last item written whole
+    REQUIRE((max_step <= max_bytes || max_step - max_bytes <= max_whole));
+    if(max_bytes < expected.size()) {
+      REQUIRE(num_steps > 1);
+    }
+
+    REQUIRE(iar.size() == static_cast<std::streamsize>(output.size()));
+    REQUIRE(output.size() == expected.size());
+    REQUIRE(std::memcmp(output.data(), expected.data(), expected.size()) == 0);
+    REQUIRE(iar.step(max_bytes));
+  }
+
+  // time slices
+  ciri::OutputBuffer output;
+  ciri::IncrementalSerializer iar(output);
+  iar.start(records, index, values, str);
+  while(!iar.step(std::numeric_limits<size_t>::max(), std::chrono::microseconds(10)));
+  REQUIRE(iar.size() > 0);
+
+  // a time-only step stops within a large vector
+  {
+    std::vector<double> large(1 << 22, 1.0);
+    ciri::OutputBuffer slices;
+    ciri::IncrementalSerializer sar(slices);
+    sar.start(large);
+    REQUIRE(!sar.step(std::numeric_limits<size_t>::max(), std::chrono::microseconds(1)));
+    REQUIRE(slices.size() < large.size() * sizeof(double));
+    while(!sar.step(std::numeric_limits<size_t>::max(), std::chrono::microseconds(100)));
+    REQUIRE(sar.size() == static_cast<std::streamsize>(slices.size()));
+    
+    ciri::OutputBuffer whole;
+    ciri::Serializer oar(whole);
+    oar(large);
+    REQUIRE(slices.size() == whole.size());
+    REQUIRE(std::memcmp(slices.data(), whole.data(), whole.size()) == 0);
+  }
+
+  // a device error leaves the rest to reset
+  iar.start(values);
+  iar.reset();
+  REQUIRE(iar.done());
+}
+
+#ifdef CIRI_COROUTINE
+
+// Struct: AsyncPipe
+// In-memory non-blocking stream of limited capacity. Its awaitables park the
+// coroutine until the test loop sees the pipe ready and resumes it.
+struct AsyncPipe {
+
+  struct Park {
+    std::coroutine_handle<>& slot;
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> h) { slot = h; }
+    void await_resume() {}
+  };
+
+  std::string bytes;
+  size_t capacity;
+  bool closed {false};
+
+  std::coroutine_handle<> writer;
+  std::coroutine_handle<> reader;
+
+  std::streamsize write_some(const char* data, std::streamsize n) {
+    auto k = std::min<size_t>(n, capacity - bytes.size());
+    bytes.append(data, k);
+    return k;
+  }
+
+  std::streamsize read_some(char* data, std::streamsize n) {
+    if(bytes.empty()) {
+      return closed ? -1 : 0;
+    }
+    auto k = std::min<size_t>(n, bytes.size());
+    std::memcpy(data, bytes.data(), k);
+    bytes.erase(0, k);
+    return k;
+  }
+
+  Park writable() { return {writer}; }
+  Park readable() { return {reader}; }
+  
+  // resumes a parked coroutine that can make progress
+  bool poll() {
+    if(writer && bytes.size() < capacity) {
+      std::exchange(writer, nullptr).resume();
+      return true;
+    }
+    if(reader && (!bytes.empty() || closed)) {
+      std::exchange(reader, nullptr).resume();
+      return true;
+    }
+    return false;
+  }
+};
+
+using AsyncMessage = std::tuple<
+  int, std::vector<double>, std::vector<std::string>, std::string, 
+  std::map<std::string, std::vector<std::vector<int>>>
+>;
+
+// Function: async_write
+ciri::Task<> async_write(AsyncPipe& pipe, const std::vector<AsyncMessage>& messages, size_t high_water = 100, size_t max_size = 1 << 26) {
+  ciri::AsyncSerializer oar(pipe, high_water, max_size);
+  // the pipe is closed on errors too so the reader sees a truncated frame
+  try {
+    for(const auto& [i, doubles, strings, str, nested] : messages) {
+      co_await oar(i, doubles, strings, str, nested);
+    }
+  }
+  catch(...) {
+    pipe.closed = true;
+    throw;
+  }
+  pipe.closed = true;
+}
+
+// Function: async_read
+ciri::Task<size_t> async_read(AsyncPipe& pipe, std::vector<AsyncMessage>& messages, size_t max_size) {
+  ciri::AsyncDeserializer iar(pipe, max_size);
+  size_t bytes = 0;
+  for(auto& [i, doubles, strings, str, nested] : messages) {
+    bytes += co_await iar(i, doubles, strings, str, nested);
+  }
+  co_return bytes;
+}
+
+// Procedure: test_async
+void test_async() {
+  
+  // connections interleaved on one thread
+  const size_t num_pipes = 3;
+
+  std::vector<std::vector<AsyncMessage>> o_messages(num_pipes);
+  std::vector<std::vector<AsyncMessage>> i_messages(num_pipes);
+  std::vector<AsyncPipe> pipes(num_pipes);
+  std::vector<ciri::Task<>> writers;
+  std::vector<ciri::Task<size_t>> readers;
+
+  for(size_t p=0; p<num_pipes; ++p) {
+    o_messages[p].resize(random<size_t>(1, 20));
+    for(auto& [i, doubles, strings, str, nested] : o_messages[p]) {
+      i = random<int>();
+      doubles.resize(random<size_t>(0, 5000));
+      for(auto& d : doubles) {
+        d = random<double>();
+      }
+      strings.resize(random<size_t>(0, 100));
+      for(auto& s : strings) {
+        s = random<std::string>(' ', '~', random<size_t>(0, 30));
+      }
+      str = random<std::string>(' ', '~', random<size_t>(0, 300));
+      for(size_t k=random<size_t>(0, 20); k; --k) {
+        auto& rows = nested[random<std::string>(' ', '~', random<size_t>(0, 10))];
+        rows.resize(random<size_t>(0, 10));
+        for(auto& row : rows) {
+          row.resize(random<size_t>(0, 50), random<int>());
+        }
+      }
+    }
+    i_messages[p].resize(o_messages[p].size());
+    pipes[p].capacity = 1 + p * 64;
+    writers.push_back(async_write(pipes[p], o_messages[p]));
+    readers.push_back(async_read(pipes[p], i_messages[p], 1 << 26));
+    writers[p].start();
+    readers[p].start();
+  }
+
+  for(bool progress=true; progress; ) {
+    progress = false;
+    for(auto& pipe : pipes) {
+      progress |= pipe.poll();
+    }
+  }
+
+  for(size_t p=0; p<num_pipes; ++p) {
+    REQUIRE(writers[p].done());
+    REQUIRE(readers[p].done());
+    writers[p].get();
+    
+    // frames of the items as Serializer writes them
+    size_t bytes = 0;
+    for(const auto& [i, doubles, strings, str, nested] : o_messages[p]) {
+      ciri::ByteCounter counter;
+      ciri::Serializer oar(counter);
+      oar(i, doubles, strings, str, nested);
+      bytes += counter.size();
+    }
+    REQUIRE(readers[p].get() == bytes);
+    REQUIRE(i_messages[p] == o_messages[p]);
+  }
+  
+  // a frame far above max_size streams through, and the reader decodes the
+  // items that have arrived while the rest is still being sent
+  {
+    AsyncPipe pipe;
+    pipe.capacity = 4096;
+    std::vector<AsyncMessage> o(1), i(1);
+    auto& [oi, odoubles, ostrings, ostr, onested] = o[0];
+    oi = 7;
+    odoubles.resize(100000, 1.5);
+    ostrings.resize(1000, "ciri");
+    ostr = std::string(50000, 'a');
+    onested["rows"].resize(100, std::vector<int>(100, 3));
+    auto writer = async_write(pipe, o, 100, 1024);
+    auto reader = async_read(pipe, i, 1024);
+    writer.start();
+    reader.start();
+    for(int k=0; k<10; ++k) {
+      pipe.poll();
+    }
+    REQUIRE(!reader.done());
+    REQUIRE(std::get<0>(i[0]) == 7);
+    while(pipe.poll());
+    REQUIRE(reader.done());
+    writer.get();
+    REQUIRE(reader.get() > 800000);
+    REQUIRE(i == o);
+  }
+
+  // short strings in a container take no coroutine frame each, on either 
+  // side
+  {
+    AsyncPipe pipe;
+    pipe.capacity = 1 << 24;
+    std::vector<AsyncMessage> o(1), i(1);
+    std::get<2>(o[0]).resize(100000, "ciri");
+    auto writer = async_write(pipe, o, 1 << 16);
+    auto reader = async_read(pipe, i, 1 << 26);
+    auto before = num_allocations.load();
+    writer.start();
+    auto written = num_allocations.load();
+    reader.start();
+    while(pipe.poll());
+    auto read = num_allocations.load();
+    REQUIRE(reader.done());
+    REQUIRE(i == o);
+    REQUIRE(written - before < 1000);
+    REQUIRE(read - written < 1000);
+  }
+
+  // truncated streams, oversized chunks, and items encoded whole above 
+  // max_size
+  for(auto [write_max, read_max] : {std::pair<size_t, size_t>{1 << 26, 1 << 26}, {1 << 26, 16}, {16, 1 << 26}}) {
+    AsyncPipe pipe;
+    pipe.capacity = 1 << 20;
+    std::vector<AsyncMessage> o(1), i(2);
+    std::get<3>(o[0]) = std::string(100, 'a');
+    std::get<4>(o[0])[std::string(100, 'k')];
+    auto writer = async_write(pipe, o, 100, write_max);
+    auto reader = async_read(pipe, i, read_max);
+    writer.start();
+    reader.start();
+    while(pipe.poll());
+    REQUIRE(reader.done());
+    REQUIRE_THROWS_AS(reader.get(), std::system_error);
+    if(write_max == 16) {
+      REQUIRE(writer.done());
+      REQUIRE_THROWS_AS(writer.get(), std::system_error);
+    }
+  }
+}
+
+#endif
+
 // Procedure: test_tuple
 void test_tuple() {
 
@@ -652,6 +3043,62 @@ void test_tuple() {
   }
 }
 
+// Procedure: test_columnar
+void test_columnar() {
+
+  for(size_t i=0; i<64; ++i) {
+
+    const size_t num_rows = random<size_t>(1, 1024);
+    
+    std::vector<PODs> o_rows(num_rows), i_rows;
+
+    // Output archiver
+    std::ostringstream os;
+    ciri::Serializer oar(os);
+    auto osz = oar(ciri::make_columnar(o_rows));
+
+    // Input archiver
+    std::istringstream is(os.str());
+    ciri::Deserializer iar(is);
+    auto isz = iar(ciri::make_columnar(i_rows));
+
+    REQUIRE(0 == is.rdbuf()->in_avail());
+    REQUIRE(osz == isz);
+    REQUIRE(o_rows == i_rows);
+
+    // Single column (_uint64 is the 10th field saved by PODs)
+    std::vector<uint64_t> i_uint64s;
+    std::istringstream cis(os.str());
+    ciri::Deserializer ciar(cis);
+    auto csz = ciar(ciri::make_column(9, i_uint64s));
+
+    REQUIRE(0 == cis.rdbuf()->in_avail());
+    REQUIRE(csz == osz);
+    REQUIRE(i_uint64s.size() == num_rows);
+    for(size_t r=0; r<num_rows; ++r) {
+      REQUIRE(i_uint64s[r] == o_rows[r]._uint64);
+    }
+  }
+
+  // Empty columnar sequence yields empty columns
+  std::vector<PODs> o_empty, i_empty(3);
+  std::ostringstream os;
+  ciri::Serializer oar(os);
+  auto osz = oar(ciri::make_columnar(o_empty));
+
+  std::istringstream is(os.str());
+  ciri::Deserializer iar(is);
+  REQUIRE(iar(ciri::make_columnar(i_empty)) == osz);
+  REQUIRE(i_empty.empty());
+
+  std::vector<uint64_t> i_uint64s(5);
+  std::istringstream cis(os.str());
+  ciri::Deserializer ciar(cis);
+  REQUIRE(ciar(ciri::make_column(9, i_uint64s)) == osz);
+  REQUIRE(0 == cis.rdbuf()->in_avail());
+  REQUIRE(i_uint64s.empty());
+}
+
 // ----------------------------------------------------------------------------
 
 // POD
@@ -739,7 +3186,135 @@ TEST_CASE("optional" * doctest::timeout(60)) {
   test_optional();
 }
 
+// std::vector and std::array of std::optional
+TEST_CASE("optionals" * doctest::timeout(60)) {
+  test_optionals();
+}
+
+// run-length encoding
+TEST_CASE("rle" * doctest::timeout(60)) {
+  test_rle();
+}
+
+// adaptive encoding
+TEST_CASE("adaptive" * doctest::timeout(60)) {
+  test_adaptive();
+}
+
+// byte and bit shuffle
+TEST_CASE("shuffle" * doctest::timeout(60)) {
+  test_shuffle<float>();
+  test_shuffle<double>();
+  test_shuffle<int16_t>();
+  test_shuffle<uint8_t>();
+}
+
+// block compression device
+TEST_CASE("compression" * doctest::timeout(60)) {
+  test_compression();
+}
+
+// CRC32C
+TEST_CASE("crc32c" * doctest::timeout(60)) {
+  test_crc32c();
+}
+
+// checksum framing device
+TEST_CASE("checksum" * doctest::timeout(60)) {
+  test_checksum();
+}
+
+// Quantization
+TEST_CASE("quantized" * doctest::timeout(60)) {
+  test_quantized();
+}
+
+// Bit fields
+TEST_CASE("bits" * doctest::timeout(60)) {
+  test_bits();
+}
+
+// Views
+TEST_CASE("views" * doctest::timeout(60)) {
+  test_views();
+}
+
+// Saving views and C arrays
+TEST_CASE("save_views" * doctest::timeout(60)) {
+  test_save_views();
+}
+
+// Caller-provided storage
+TEST_CASE("into" * doctest::timeout(60)) {
+  test_into();
+}
+
+// Uninitialized resize
+TEST_CASE("default_init" * doctest::timeout(60)) {
+  test_default_init();
+}
+
+// Reuse mode
+TEST_CASE("reuse" * doctest::timeout(60)) {
+  test_reuse();
+}
+
+// Memory resources
+TEST_CASE("pmr" * doctest::timeout(60)) {
+  test_pmr();
+}
+
+// Parallel save
+TEST_CASE("parallel_save" * doctest::timeout(60)) {
+  test_parallel_save();
+}
+
+// Parallel load
+TEST_CASE("parallel_load" * doctest::timeout(60)) {
+  test_parallel_load();
+}
+
+// Partitioned unordered containers
+TEST_CASE("partitioned" * doctest::timeout(60)) {
+  test_partitioned();
+}
+
+TEST_CASE("batch" * doctest::timeout(60)) {
+  test_batch();
+}
+
+TEST_CASE("append_log" * doctest::timeout(60)) {
+  test_append_log();
+}
+
+TEST_CASE("pipeline" * doctest::timeout(60)) {
+  test_pipeline();
+}
+
+TEST_CASE("parallel_copy" * doctest::timeout(60)) {
+  test_parallel_copy();
+}
+
+TEST_CASE("striped" * doctest::timeout(60)) {
+  test_striped();
+}
+
+TEST_CASE("async" * doctest::timeout(60)) {
+#ifdef CIRI_COROUTINE
+  test_async();
+#endif
+}
+
+TEST_CASE("incremental" * doctest::timeout(60)) {
+  test_incremental();
+}
+
 // std::tuple
 TEST_CASE("tuple" * doctest::timeout(60)) {
   test_tuple();
 }
+
+// columnar std::vector
+TEST_CASE("columnar" * doctest::timeout(60)) {
+  test_columnar();
+}